@@ -0,0 +1,94 @@
+#ifndef HASHING_BULK_BUILD_H_INCLUDED
+#define HASHING_BULK_BUILD_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <exception>
+
+namespace hashing{
+
+/*
+ * Helpers for building a table from a known set of pairs.
+ *
+ * The table is split into contiguous regions, one per thread, and each
+ * pair goes to the region holding the cell its hash starts probing from.
+ * Threads then fill their own regions without touching anyone else's
+ * cells.  Pairs whose probe runs off the end of their region are left for
+ * the caller to insert afterwards, one at a time.
+ */
+struct bulk_entry{
+	std::size_t index;	//Where the pair is in the input.
+	std::size_t hash;
+};
+
+/*
+ * Calls f(0), ..., f(n - 1) on n threads (including this one), then
+ * rethrows the first exception any of them threw.
+ */
+template <class F>
+void run_parallel(std::size_t n, F f){
+	std::vector<std::exception_ptr> errors(n);
+	std::vector<std::thread> workers;
+	workers.reserve(n - 1);
+	for(std::size_t i = 1; i < n; ++i){
+		workers.emplace_back([&f, &errors, i](){
+			try{
+				f(i);
+			}catch(...){
+				errors[i] = std::current_exception();
+			}
+		});
+	}
+	try{
+		f(0);
+	}catch(...){
+		errors[0] = std::current_exception();
+	}
+	for(auto i = workers.begin(); i != workers.end(); ++i){
+		i->join();
+	}
+	for(auto i = errors.begin(); i != errors.end(); ++i){
+		if(*i){
+			std::rethrow_exception(*i);
+		}
+	}
+}
+
+/*
+ * Which of parts regions of a table with size cells the given cell is in.
+ */
+inline std::size_t region_of(std::size_t cell, std::size_t size, std::size_t parts){
+	return std::size_t(std::uint64_t(cell) * parts / size);
+}
+
+/*
+ * The first cell of the given region (or size, for region parts).
+ */
+inline std::size_t region_begin(std::size_t region, std::size_t size, std::size_t parts){
+	return std::size_t((std::uint64_t(size) * region + parts - 1) / parts);
+}
+
+/*
+ * Hashes the pairs [0, count) on parts threads (hash_of(i) hashes the
+ * i-th one) and sorts them by region_for(hash).  The result is indexed by
+ * [slice][region], and reading a region's entries slice by slice visits
+ * them in input order, so later duplicates of a key still win.
+ */
+template <class HashOf, class RegionFor>
+std::vector<std::vector<std::vector<bulk_entry>>> partition(std::size_t count, std::size_t parts, HashOf hash_of, RegionFor region_for){
+	std::vector<std::vector<std::vector<bulk_entry>>> slices(parts, std::vector<std::vector<bulk_entry>>(parts));
+	run_parallel(parts, [&](std::size_t slice){
+		std::size_t first = std::size_t(std::uint64_t(count) * slice / parts), last = std::size_t(std::uint64_t(count) * (slice + 1) / parts);
+		for(std::size_t i = first; i < last; ++i){
+			std::size_t hash = hash_of(i);
+			slices[slice][region_for(hash)].push_back(bulk_entry{i, hash});
+		}
+	});
+	return slices;
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef HASHING_CONTROL_GROUP_H_INCLUDED
+#define HASHING_CONTROL_GROUP_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hashing{
+
+/*
+ * Control bytes for group probing (as in Swiss tables).
+ *
+ * Each cell of a table has a control byte alongside it: a 7-bit tag taken
+ * from its key's hash while it's full, or one of the negative markers
+ * below.  A control_group loads 16 consecutive control bytes, and finds
+ * the cells in them with a given tag (or that are free) all at once, so
+ * probes only touch a cell's key when its tag already matches.
+ */
+using control_byte = signed char;
+
+constexpr control_byte empty_control = -128;
+constexpr control_byte tombstone_control = -2;
+
+/*
+ * The 7 high bits of a multiplicative mix of the hash, since tables index
+ * with the low bits of the hash (and std::hash of an integer is itself).
+ */
+inline control_byte tag_of(std::size_t hash){
+	return control_byte((std::uint64_t(hash) * 0x9E3779B97F4A7C15ull) >> 57);
+}
+
+/*
+ * Matches return a bitmask, with bit i set if the group's i-th byte matches.
+ */
+class control_group{
+public:
+	
+	//Constructors/Destructor
+	explicit control_group(const control_byte* c);
+	
+	//Member Functions
+	unsigned int match(control_byte tag) const;
+	unsigned int match_empty() const {return match(empty_control);}
+	unsigned int match_free() const;	//Empty cells and tombstones.
+	
+	//Static Data Members
+	static constexpr std::size_t width = 16;
+	
+private:
+	
+	//Data Members
+#if defined(__SSE2__)
+	__m128i bytes;
+#else
+	control_byte bytes[width];
+#endif
+
+};
+
+#if defined(__SSE2__)
+
+inline control_group::control_group(const control_byte* c) : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(c))) {}
+
+inline unsigned int control_group::match(control_byte tag) const{
+	return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag))));
+}
+
+inline unsigned int control_group::match_free() const{
+	return unsigned(_mm_movemask_epi8(bytes));	//Only the markers have their sign bit set.
+}
+
+#else
+
+inline control_group::control_group(const control_byte* c){
+	std::memcpy(bytes, c, width);
+}
+
+inline unsigned int control_group::match(control_byte tag) const{
+	unsigned int mask = 0;
+	for(std::size_t i = 0; i < width; ++i){
+		mask |= unsigned(bytes[i] == tag) << i;
+	}
+	return mask;
+}
+
+inline unsigned int control_group::match_free() const{
+	unsigned int mask = 0;
+	for(std::size_t i = 0; i < width; ++i){
+		mask |= unsigned(bytes[i] < 0) << i;
+	}
+	return mask;
+}
+
+#endif
+
+}
+
+#endif
\ No newline at end of file
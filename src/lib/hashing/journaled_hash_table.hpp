@@ -0,0 +1,406 @@
+#ifndef HASHING_JOURNALED_HASH_TABLE_H_INCLUDED
+#define HASHING_JOURNALED_HASH_TABLE_H_INCLUDED
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <system_error>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace hashing{
+
+/*
+ * A hash table (locking or lockfree) whose sets and removes are also
+ * written to a journal file, so that it can be rebuilt after a crash.
+ *
+ * Each thread appends its records to a buffer of its own, and a background
+ * thread writes every buffer out together about once per flush_interval,
+ * with a single fdatasync per batch (a group commit).  The flusher sleeps
+ * while nothing is buffered, and is woken early by a sync or a full buffer.
+ * Writers never wait on the disk, and sync blocks until everything changed
+ * before it was called is durable.
+ *
+ * A batch which can't be written in full is cut back off the file, so the
+ * journal never has a torn record in the middle.  After that the journal
+ * is failed: sync, set and remove throw rather than leave a gap in it.
+ *
+ * Records carry a sequence number, taken under a lock striped by key
+ * alongside the change itself, so that replaying the records in sequence
+ * order repeats each key's changes in the order they took effect.  A
+ * record torn by a crash ends the journal, and is cut off when the journal
+ * is next opened.
+ *
+ * Keys and values must be trivially copyable, as records hold their bytes.
+ */
+template <class Table>
+class journaled_hash_table{
+public:
+	
+	//Public Types
+	using size_type = typename Table::size_type;
+	using key_type = typename Table::key_type;
+	using value_type = typename Table::value_type;
+	using hasher = typename Table::hasher;
+	using comparer = typename Table::comparer;
+	
+	//Constructors/Destructor
+	journaled_hash_table(const std::string& path, size_type s = 1);	//Replays the journal at path (if there is one), then appends to it.
+	journaled_hash_table(const journaled_hash_table&) = delete;
+	journaled_hash_table(journaled_hash_table&&) = delete;
+	~journaled_hash_table();
+	
+	//Assignment Operators
+	journaled_hash_table& operator=(const journaled_hash_table&) = delete;
+	journaled_hash_table& operator=(journaled_hash_table&&) = delete;
+	
+	//Member Functions
+	bool get(const key_type& key, value_type& ret_value) const {return table.get(key, ret_value);}
+	void set(const key_type& key, const value_type& value);
+	void remove(const key_type& key);
+	void sync();
+	template <class F> void for_each(F&& f) const {table.for_each(std::forward<F>(f));}
+	static std::size_t replay(const std::string& path, Table& target);
+	
+	//Static Data Members
+	static constexpr std::chrono::milliseconds flush_interval{2};
+	static constexpr std::size_t buffer_limit = 1 << 20;	//Bytes a thread may buffer before it wakes the flusher early.
+	
+private:
+	
+	//Private Types
+	enum record_type : unsigned char {set_record = 1, remove_record = 2};
+	struct file_header{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t key_size;
+		std::uint32_t value_size;
+		std::uint32_t reserved;
+	};
+	struct alignas(64) thread_buffer{	//Aligned so that threads' buffers don't share a cache line.
+		std::mutex mu;	//Only ever contended by the flusher.
+		std::vector<char> records;
+	};
+	struct alignas(64) stripe_lock{
+		std::mutex mu;
+	};
+	
+	//Data Members
+	Table table;
+	int fd;
+	std::atomic<std::uint64_t> next_sequence;
+	std::array<stripe_lock, 64> stripe_locks;
+	std::uint64_t id;	//Tells this journal's buffers apart in each thread's cache.
+	std::mutex buffers_mu;	//Guards the list of buffers, not their contents.
+	std::vector<std::unique_ptr<thread_buffer>> buffers;
+	std::atomic<bool> dirty;	//Whether anything has been buffered since the flusher last took the buffers.
+	std::atomic<int> flush_error;	//The errno value which failed the journal (or 0).
+	std::uint64_t length;	//Bytes of the file known to be good, only used by the flusher once it starts.
+	std::mutex flush_mu;	//Guards the members below.
+	std::condition_variable flush_cv;
+	bool stopping;
+	bool buffer_full;	//Some thread's buffer reached buffer_limit.
+	std::uint64_t requested;	//Syncs asked for.
+	std::uint64_t committed;	//Syncs done.
+	std::thread flusher;
+	
+	//Static Data Members
+	static constexpr char journal_magic[8] = {'H', 'T', 'J', 'R', 'N', 'L', '\0', '\0'};
+	static constexpr std::uint32_t journal_version = 1;
+	static constexpr std::size_t record_prefix = sizeof(std::uint64_t) + 1;	//The sequence number and record_type.
+	static std::atomic<std::uint64_t> next_id;
+	
+	//Private Member Functions
+	std::mutex& stripe_of(const key_type& key);
+	void check_failed() const;
+	void append(record_type type, std::uint64_t sequence, const key_type& key, const value_type* value);
+	thread_buffer& local_buffer();
+	void flush_loop();
+	int write_out();
+	static bool load(const std::string& path, Table& target, std::uint64_t& ret_sequence, std::size_t& ret_records, std::uint64_t& ret_length);
+	
+};
+
+template <class Table>
+std::atomic<std::uint64_t> journaled_hash_table<Table>::next_id(0);
+
+template <class Table>
+journaled_hash_table<Table>::journaled_hash_table(const std::string& path, size_type s) : table(s), fd(-1), next_sequence(0), stripe_locks(), id(next_id++), buffers_mu(), buffers(), dirty(false), flush_error(0), length(0), flush_mu(), flush_cv(), stopping(false), buffer_full(false), requested(0), committed(0), flusher(){
+	static_assert(std::is_trivially_copyable_v<key_type> && std::is_trivially_copyable_v<value_type>, "Journals need trivially copyable keys and values.");
+	std::uint64_t sequence = 0;
+	std::size_t records = 0;
+	bool existed = load(path, table, sequence, records, length);
+	next_sequence = sequence;
+	
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if(fd < 0){
+		throw std::system_error(errno, std::generic_category(), "Couldn't open " + path);
+	}
+	int error = 0;
+	if(existed){
+		if(::ftruncate(fd, off_t(length)) != 0){	//Cuts off a record torn by a crash.
+			error = errno;
+		}
+	}else{
+		file_header header{};
+		std::memcpy(header.magic, journal_magic, sizeof(header.magic));
+		header.version = journal_version;
+		header.key_size = sizeof(key_type);
+		header.value_size = sizeof(value_type);
+		if(::ftruncate(fd, 0) != 0 || ::write(fd, &header, sizeof(header)) != ssize_t(sizeof(header)) || ::fdatasync(fd) != 0){
+			error = errno != 0 ? errno : EIO;
+		}
+		length = sizeof(header);
+	}
+	if(error != 0){
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), "Couldn't prepare " + path);
+	}
+	flusher = std::thread(&journaled_hash_table::flush_loop, this);
+}
+
+template <class Table>
+journaled_hash_table<Table>::~journaled_hash_table(){	//Writes out whatever is still buffered.
+	{
+		std::lock_guard lk(flush_mu);
+		stopping = true;
+	}
+	flush_cv.notify_all();
+	flusher.join();
+	::close(fd);
+}
+
+template <class Table>
+void journaled_hash_table<Table>::set(const key_type& key, const value_type& value){
+	check_failed();
+	std::uint64_t sequence;
+	{
+		std::lock_guard lk(stripe_of(key));	//Keeps the change and its sequence number in the same order as other changes to the key.
+		table.set(key, value);
+		sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+	}
+	append(set_record, sequence, key, &value);
+}
+
+template <class Table>
+void journaled_hash_table<Table>::remove(const key_type& key){
+	check_failed();
+	std::uint64_t sequence;
+	{
+		std::lock_guard lk(stripe_of(key));
+		table.remove(key);
+		sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+	}
+	append(remove_record, sequence, key, nullptr);
+}
+
+template <class Table>
+void journaled_hash_table<Table>::sync(){	//Blocks until every earlier set and remove is on disk, throws if the journal couldn't be written.
+	std::unique_lock lk(flush_mu);
+	std::uint64_t ticket = ++requested;
+	flush_cv.notify_all();
+	flush_cv.wait(lk, [&](){return committed >= ticket;});
+	lk.unlock();
+	check_failed();
+}
+
+template <class Table>
+std::size_t journaled_hash_table<Table>::replay(const std::string& path, Table& target){	//Applies a journal's records to a table, returns how many there were.
+	std::uint64_t sequence, length;
+	std::size_t records = 0;
+	if(!load(path, target, sequence, records, length)){
+		throw std::runtime_error("Couldn't read a journal from " + path);
+	}
+	return records;
+}
+
+template <class Table>
+void journaled_hash_table<Table>::check_failed() const{
+	int error = flush_error.load();
+	if(error != 0){
+		throw std::system_error(error, std::generic_category(), "Couldn't write the journal");
+	}
+}
+
+template <class Table>
+std::mutex& journaled_hash_table<Table>::stripe_of(const key_type& key){
+	std::uint64_t mixed = std::uint64_t(hasher()(key)) * 0x9E3779B97F4A7C15ull;	//Same mix as striped_hash_table.
+	return stripe_locks[(mixed >> 32) % stripe_locks.size()].mu;
+}
+
+template <class Table>
+void journaled_hash_table<Table>::append(record_type type, std::uint64_t sequence, const key_type& key, const value_type* value){
+	thread_buffer& buffer = local_buffer();
+	bool full;
+	{
+		std::lock_guard lk(buffer.mu);
+		std::size_t at = buffer.records.size();
+		buffer.records.resize(at + record_prefix + sizeof(key_type) + (value != nullptr ? sizeof(value_type) : 0));
+		char* record = buffer.records.data() + at;
+		std::memcpy(record, &sequence, sizeof(sequence));
+		record[sizeof(sequence)] = char(type);
+		std::memcpy(record + record_prefix, &key, sizeof(key_type));
+		if(value != nullptr){
+			std::memcpy(record + record_prefix + sizeof(key_type), value, sizeof(value_type));
+		}
+		full = buffer.records.size() >= buffer_limit;
+	}
+	if(full || (!dirty.load(std::memory_order_relaxed) && !dirty.exchange(true))){	//Only the first record after a flush wakes a sleeping flusher.
+		{
+			std::lock_guard lk(flush_mu);	//Held while notifying, so the flusher can't miss it between checking and waiting.
+			buffer_full = buffer_full || full;
+		}
+		flush_cv.notify_all();
+	}
+}
+
+template <class Table>
+typename journaled_hash_table<Table>::thread_buffer& journaled_hash_table<Table>::local_buffer(){
+	static thread_local std::vector<std::pair<std::uint64_t, thread_buffer*>> cache;	//Ids are never reused, so entries for closed journals are just never matched.
+	for(auto i = cache.begin(); i != cache.end(); ++i){
+		if(i->first == id){
+			return *i->second;
+		}
+	}
+	std::lock_guard lk(buffers_mu);
+	buffers.push_back(std::make_unique<thread_buffer>());
+	cache.emplace_back(id, buffers.back().get());
+	return *buffers.back();
+}
+
+template <class Table>
+void journaled_hash_table<Table>::flush_loop(){
+	std::unique_lock lk(flush_mu);
+	while(true){
+		auto urgent = [this](){return stopping || buffer_full || requested > committed;};
+		flush_cv.wait(lk, [&](){return urgent() || dirty.load();});	//Nothing to write, so no need to wake up.
+		flush_cv.wait_for(lk, flush_interval, urgent);	//Gathers a batch, unless someone is waiting on it.
+		bool stop = stopping;
+		std::uint64_t target = requested;	//Every change made before these syncs is already in some buffer.
+		buffer_full = false;
+		lk.unlock();
+		dirty.store(false);	//Before the buffers are taken, so a record buffered after that marks them dirty again.
+		int error = write_out();
+		lk.lock();
+		if(error != 0 && flush_error.load() == 0){
+			flush_error.store(error);
+		}
+		committed = target;
+		flush_cv.notify_all();
+		if(stop){
+			return;
+		}
+	}
+}
+
+template <class Table>
+int journaled_hash_table<Table>::write_out(){	//Writes every buffer out as one batch, returns an errno value (or 0).
+	std::vector<thread_buffer*> current;
+	{
+		std::lock_guard lk(buffers_mu);
+		for(auto i = buffers.begin(); i != buffers.end(); ++i){
+			current.push_back(i->get());
+		}
+	}
+	std::vector<char> batch, taken;
+	for(thread_buffer* buffer : current){
+		{
+			std::lock_guard lk(buffer->mu);
+			taken.swap(buffer->records);
+		}
+		batch.insert(batch.end(), taken.begin(), taken.end());
+		taken.clear();
+	}
+	if(batch.empty() || flush_error.load() != 0){
+		return 0;	//A failed journal has a gap where the failed batch was, so nothing after it can be written.
+	}
+	
+	for(std::size_t written = 0; written < batch.size();){
+		ssize_t n = ::write(fd, batch.data() + written, batch.size() - written);
+		if(n <= 0){
+			if(n < 0 && errno == EINTR){
+				continue;
+			}
+			int error = n < 0 ? errno : EIO;
+			if(::ftruncate(fd, off_t(length)) != 0){	//Cuts the partial batch back off, so a replay still reads every earlier record.
+				error = errno;	//Then the torn record ends the journal instead, as after a crash.
+			}
+			return error;
+		}
+		written += std::size_t(n);
+	}
+	length += batch.size();
+	return ::fdatasync(fd) == 0 ? 0 : errno;	//One sync for the whole batch.
+}
+
+template <class Table>
+bool journaled_hash_table<Table>::load(const std::string& path, Table& target, std::uint64_t& ret_sequence, std::size_t& ret_records, std::uint64_t& ret_length){	//Returns false if there's no journal yet, throws if the file isn't one.
+	std::ifstream in(path, std::ios::binary);
+	if(!in){
+		return false;
+	}
+	std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if(contents.size() < sizeof(file_header)){
+		return false;	//Created, but the header never made it to disk.
+	}
+	file_header header;
+	std::memcpy(&header, contents.data(), sizeof(header));
+	if(std::memcmp(header.magic, journal_magic, sizeof(header.magic)) != 0 || header.version != journal_version){
+		throw std::runtime_error(path + " isn't a hash table journal (or is one from another version).");
+	}
+	if(header.key_size != sizeof(key_type) || header.value_size != sizeof(value_type)){
+		throw std::runtime_error("The journal's keys or values are of another type.");
+	}
+	
+	std::vector<std::pair<std::uint64_t, std::size_t>> records;	//Sequence numbers and offsets.
+	std::size_t at = sizeof(header);
+	while(at + record_prefix + sizeof(key_type) <= contents.size()){
+		record_type type = record_type(contents[at + sizeof(std::uint64_t)]);
+		std::size_t length = record_prefix + sizeof(key_type) + (type == set_record ? sizeof(value_type) : 0);
+		if((type != set_record && type != remove_record) || at + length > contents.size()){
+			break;	//Torn by a crash.
+		}
+		std::uint64_t sequence;
+		std::memcpy(&sequence, contents.data() + at, sizeof(sequence));
+		records.emplace_back(sequence, at);
+		at += length;
+	}
+	std::sort(records.begin(), records.end());	//Batches hold each thread's records in order, but interleave threads arbitrarily.
+	
+	for(auto i = records.begin(); i != records.end(); ++i){
+		const char* record = contents.data() + i->second;
+		key_type key;
+		std::memcpy(&key, record + record_prefix, sizeof(key_type));
+		if(record_type(record[sizeof(std::uint64_t)]) == set_record){
+			value_type value;
+			std::memcpy(&value, record + record_prefix + sizeof(key_type), sizeof(value_type));
+			target.set(key, value);
+		}else{
+			target.remove(key);
+		}
+	}
+	ret_sequence = records.empty() ? 0 : records.back().first + 1;
+	ret_records = records.size();
+	ret_length = at;
+	return true;
+}
+
+}
+
+#endif
\ No newline at end of file
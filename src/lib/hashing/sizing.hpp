@@ -0,0 +1,76 @@
+#ifndef HASHING_SIZING_H_INCLUDED
+#define HASHING_SIZING_H_INCLUDED
+
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+
+namespace hashing{
+
+/*
+ * Sizing policies for the hash tables (both locking and lockfree).
+ *
+ * A policy decides which sizes a table may have (round), which cell a
+ * hash starts probing from (home), and how probe positions wrap around
+ * the end of the table (wrap).
+ */
+
+/*
+ * Passes hashes through untouched.
+ */
+struct identity_finalizer{
+	std::size_t operator()(std::size_t hash) const {return hash;}
+};
+
+/*
+ * MurmurHash3's 64-bit finalizer.  Every input bit affects every output
+ * bit, so dense keys (and std::hash's identity hash of integers) spread
+ * over the low bits which a mask keeps.
+ */
+struct murmur_finalizer{
+	std::size_t operator()(std::size_t hash) const{
+		std::uint64_t h = hash;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return std::size_t(h);
+	}
+};
+
+/*
+ * Any size, with modulo indexing.  Hashes are used as they are.
+ */
+struct modulo_sizing{
+	template <class S> static S round(S s) {return s;}
+	template <class S> static S home(std::size_t hash, S size) {return S(hash % size);}
+	template <class S> static S wrap(S i, S size) {return i % size;}
+};
+
+/*
+ * Sizes rounded up to powers of two, so indexing is a mask rather than
+ * a division.  Since a mask only keeps the low bits, hashes go through
+ * the Finalizer first.
+ */
+template <class Finalizer = murmur_finalizer>
+struct power_of_two_sizing{
+	template <class S> static S round(S s);
+	template <class S> static S home(std::size_t hash, S size) {return S(Finalizer()(hash) & std::size_t(size - 1));}
+	template <class S> static S wrap(S i, S size) {return i & (size - 1);}
+};
+
+template <class Finalizer>
+template <class S>
+S power_of_two_sizing<Finalizer>::round(S s){	//Sizes above the largest power of two S can hold are clamped to it, rather than overflowing.
+	constexpr std::uint64_t largest = (std::uint64_t(std::numeric_limits<S>::max()) >> 1) + 1;
+	std::uint64_t p = 1;
+	while(p < largest && S(p) < s){
+		p <<= 1;
+	}
+	return S(p);
+}
+
+}
+
+#endif
\ No newline at end of file
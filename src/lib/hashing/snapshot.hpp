@@ -0,0 +1,100 @@
+#ifndef HASHING_SNAPSHOT_H_INCLUDED
+#define HASHING_SNAPSHOT_H_INCLUDED
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace hashing{
+
+/*
+ * The on-disk layout of a table snapshot.
+ *
+ * A header, then the table's control bytes, then one slot (key and value,
+ * as they are in memory) per cell, each part starting on a
+ * snapshot_alignment boundary.  Snapshots are only meant to be read on the
+ * machine (and by the build) which wrote them, so the checks below are
+ * there to catch mistakes, not to make the format portable.
+ */
+struct snapshot_header{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t key_size;
+	std::uint32_t value_size;
+	std::uint32_t slot_size;
+	std::uint64_t size;
+	std::uint64_t capacity;
+	std::uint64_t used_size;
+	std::uint64_t tombstones;
+	std::uint64_t hash_check;	//The hash of a default key, so that a snapshot isn't read with a different hasher.
+	std::uint64_t home_check;	//Likewise for the sizing policy.
+	std::uint64_t controls_offset;
+	std::uint64_t slots_offset;
+};
+
+constexpr char snapshot_magic[8] = {'H', 'T', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr std::uint32_t snapshot_version = 1;
+constexpr std::uint64_t snapshot_alignment = 64;
+
+inline std::uint64_t snapshot_align(std::uint64_t offset){
+	return (offset + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+}
+
+/*
+ * A whole file, mapped read-only.  The mapping is private, so nothing done
+ * to the file afterwards shows up in it (as far as the OS allows).
+ */
+class mapped_file{
+public:
+	
+	//Constructors/Destructor
+	explicit mapped_file(const std::string& path);
+	mapped_file(const mapped_file&) = delete;
+	mapped_file(mapped_file&&) = delete;
+	~mapped_file() {::munmap(bytes, file_length);}
+	
+	//Assignment Operators
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file& operator=(mapped_file&&) = delete;
+	
+	//Member Functions
+	const unsigned char* data() const {return static_cast<const unsigned char*>(bytes);}
+	std::size_t length() const {return file_length;}
+	
+private:
+	
+	//Data Members
+	void* bytes;
+	std::size_t file_length;
+	
+};
+
+inline mapped_file::mapped_file(const std::string& path) : bytes(nullptr), file_length(0){
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0){
+		throw std::system_error(errno, std::generic_category(), "Couldn't open " + path);
+	}
+	struct stat info;
+	int error = ::fstat(fd, &info) != 0 ? errno : info.st_size <= 0 ? EINVAL : 0;	//errno is saved before close can change it, and info is only read if fstat filled it in.
+	if(error != 0){
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), "Couldn't read " + path);
+	}
+	file_length = std::size_t(info.st_size);
+	bytes = ::mmap(nullptr, file_length, PROT_READ, MAP_PRIVATE, fd, 0);
+	error = errno;
+	::close(fd);	//The mapping stays valid without the descriptor.
+	if(bytes == MAP_FAILED){
+		throw std::system_error(error, std::generic_category(), "Couldn't map " + path);
+	}
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef HASHING_TRANSPARENT_H_INCLUDED
+#define HASHING_TRANSPARENT_H_INCLUDED
+
+#include <type_traits>
+
+namespace hashing{
+
+/*
+ * Whether a table with this hasher and comparer may be searched with keys
+ * of other types (e.g. std::string_view for std::string keys).  As with
+ * the standard containers, both must declare an is_transparent type.
+ */
+template <class Hash, class Compare, class = void>
+struct is_transparent : std::false_type {};
+
+template <class Hash, class Compare>
+struct is_transparent<Hash, Compare, std::void_t<typename Hash::is_transparent, typename Compare::is_transparent>> : std::true_type {};
+
+template <class Hash, class Compare>
+constexpr bool is_transparent_v = is_transparent<Hash, Compare>::value;
+
+}
+
+#endif
\ No newline at end of file
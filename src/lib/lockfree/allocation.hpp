@@ -0,0 +1,227 @@
+#ifndef LOCKFREE_ALLOCATION_H_INCLUDED
+#define LOCKFREE_ALLOCATION_H_INCLUDED
+
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+namespace lockfree{
+
+/*
+ * Allocation policies for the nodes behind the lockfree pointers
+ * (double_ref_counter, epoch_ptr and hazard_ptr).
+ *
+ * A policy supplies create<T>(args...), which returns a new T, and
+ * destroy(ptr), which deletes one made by create.  Either may be called
+ * from any thread.
+ */
+
+/*
+ * Plain global new and delete.
+ */
+struct new_allocator{
+	template <class T, class... Args> static T* create(Args&&... args) {return new T(std::forward<Args>(args)...);}
+	template <class T> static void destroy(T* ptr) {delete ptr;}
+};
+
+/*
+ * Per-thread free lists of fixed size blocks.
+ *
+ * Each thread allocates from and frees to its own pool without any
+ * synchronization.  Blocks freed by other threads are pushed onto a
+ * lockfree stack belonging to the pool they came from, and the owning
+ * thread takes the whole stack back once its own list runs dry.
+ *
+ * Pools are handed to a new thread when their thread exits, and their
+ * memory is never returned to the system.
+ */
+template <std::size_t Size>
+class node_pool{
+public:
+	
+	//Constructors/Destructor
+	node_pool(const node_pool&) = delete;
+	node_pool(node_pool&&) = delete;
+	
+	//Assignment Operators
+	node_pool& operator=(const node_pool&) = delete;
+	node_pool& operator=(node_pool&&) = delete;
+	
+	//Static Member Functions
+	static void* allocate();
+	static void deallocate(void* ptr);
+	
+private:
+	
+	//Private Types
+	struct alignas(alignof(std::max_align_t)) block{	//Header in front of every node, keeps the node suitably aligned.
+		node_pool* owner;
+		block* next;
+	};
+	class thread_cache;
+	
+	//Private Constructors
+	node_pool() : local(nullptr), remote(nullptr), in_use(true), next_pool(nullptr) {}
+	~node_pool() = delete;	//Pools are never destroyed, since their blocks may outlive any thread.
+	
+	//Data Members
+	block* local;	//Only touched by the owning thread.
+	alignas(64) std::atomic<block*> remote;	//Kept off the local list's cache line, since every thread may write it.
+	std::atomic<bool> in_use;
+	node_pool* next_pool;
+	
+	//Static Data Members
+	static constexpr std::size_t stride = (sizeof(block) + Size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+	static constexpr std::size_t blocks_per_chunk = 64;
+	static thread_local bool cache_destroyed;	//Trivially destructible, so it can still be read once the thread's cache has been destroyed.
+	
+	//Private Member Functions
+	void refill();
+	
+	//Private Static Member Functions
+	static node_pool* local_pool();
+	static node_pool& acquire_pool();
+	static std::atomic<node_pool*>& pools();
+	
+};
+
+/*
+ * Gives up the calling thread's pool when it exits.
+ */
+template <std::size_t Size>
+class node_pool<Size>::thread_cache{
+public:
+	
+	//Constructors/Destructor
+	thread_cache() : pool(&acquire_pool()) {}
+	thread_cache(const thread_cache&) = delete;
+	thread_cache(thread_cache&&) = delete;
+	~thread_cache() {pool->in_use.store(false, std::memory_order_release); cache_destroyed = true;}
+	
+	//Assignment Operators
+	thread_cache& operator=(const thread_cache&) = delete;
+	thread_cache& operator=(thread_cache&&) = delete;
+	
+	//Data Members
+	node_pool* pool;
+	
+};
+
+template <std::size_t Size>
+thread_local bool node_pool<Size>::cache_destroyed = false;
+
+template <std::size_t Size>
+void* node_pool<Size>::allocate(){
+	node_pool* pool = local_pool();
+	if(pool == nullptr){	//Only once the thread's cache is gone (i.e. during thread exit).
+		block* b = static_cast<block*>(::operator new(stride));
+		b->owner = nullptr;
+		return b + 1;
+	}
+	
+	if(pool->local == nullptr){
+		pool->refill();
+	}
+	block* b = pool->local;
+	pool->local = b->next;
+	return b + 1;
+}
+
+template <std::size_t Size>
+void node_pool<Size>::deallocate(void* ptr){
+	block* b = static_cast<block*>(ptr) - 1;
+	node_pool* pool = local_pool();
+	if(b->owner == nullptr){	//Allocated during thread exit.
+		::operator delete(b);
+	}else if(b->owner == pool){	//Never true during thread exit, since pool is null then.
+		b->next = pool->local;
+		pool->local = b;
+	}else{
+		b->next = b->owner->remote.load(std::memory_order_relaxed);
+		while(!b->owner->remote.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed)){}
+	}
+}
+
+template <std::size_t Size>
+void node_pool<Size>::refill(){
+	local = remote.exchange(nullptr, std::memory_order_acquire);	//Only the owner pops, and it takes everything, so there's no ABA problem.
+	if(local != nullptr){
+		return;
+	}
+	
+	char* chunk = static_cast<char*>(::operator new(stride * blocks_per_chunk));
+	for(std::size_t i = 0; i < blocks_per_chunk; ++i){
+		block* b = reinterpret_cast<block*>(chunk + i * stride);
+		b->owner = this;
+		b->next = local;
+		local = b;
+	}
+}
+
+template <std::size_t Size>
+node_pool<Size>* node_pool<Size>::local_pool(){
+	if(cache_destroyed){	//The cache mustn't be touched after its destructor has run.
+		return nullptr;
+	}
+	static thread_local thread_cache cache;
+	return cache.pool;
+}
+
+template <std::size_t Size>
+node_pool<Size>& node_pool<Size>::acquire_pool(){
+	for(node_pool* p = pools().load(std::memory_order_acquire); p != nullptr; p = p->next_pool){	//Adopt a pool left behind by a thread which has exited.
+		bool expected = false;
+		if(!p->in_use.load() && p->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)){
+			return *p;
+		}
+	}
+	
+	node_pool* pool = new node_pool();
+	pool->next_pool = pools().load();
+	while(!pools().compare_exchange_weak(pool->next_pool, pool, std::memory_order_release)){}
+	return *pool;
+}
+
+template <std::size_t Size>
+std::atomic<node_pool<Size>*>& node_pool<Size>::pools(){
+	static std::atomic<node_pool*> head(nullptr);
+	return head;
+}
+
+/*
+ * Allocates nodes from node_pools, one pool per node size.
+ * Once warmed up, steady-state replacements never reach the global allocator.
+ */
+struct pooled_allocator{
+	template <class T, class... Args> static T* create(Args&&... args);
+	template <class T> static void destroy(T* ptr);
+};
+
+template <class T, class... Args>
+T* pooled_allocator::create(Args&&... args){
+	static_assert(alignof(T) <= alignof(std::max_align_t), "pooled_allocator can't over-align nodes.");
+	void* mem = node_pool<sizeof(T)>::allocate();
+	try{
+		return new(mem) T(std::forward<Args>(args)...);
+	}catch(...){
+		node_pool<sizeof(T)>::deallocate(mem);
+		throw;
+	}
+}
+
+template <class T>
+void pooled_allocator::destroy(T* ptr){
+	if(ptr == nullptr){	//Like delete.
+		return;
+	}
+	using U = std::remove_cv_t<T>;
+	U* mutable_ptr = const_cast<U*>(ptr);
+	mutable_ptr->~U();
+	node_pool<sizeof(U)>::deallocate(mutable_ptr);
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <atomic>
 #include <utility>
 #include <type_traits>
+#include "allocation.hpp"
 
 namespace lockfree{
 
@@ -26,25 +27,29 @@ inline constexpr default_construct_t default_construct{};
  *
  * A const double_ref_counter can still have its ex_count modified,
  * but not its internals pointer.  Hence the funky usage of const/mutable.
+ *
+ * Internal counters are made and destroyed through the Allocator policy
+ * (see allocation.hpp).
  */
-template <class T>
+template <class T, class Allocator = new_allocator>
 class double_ref_counter{
 public:
 	
 	//Public Types
 	using value_type = T;
 	class counted_ptr;
+	using handle = counted_ptr;
 	
 	//Default and Internal Default Constructors
 	double_ref_counter() : front_end(external_counter{nullptr, 0}) {}
-	double_ref_counter(default_construct_t) : front_end(external_counter{new internal_counter(), 0}) {}		//Since the default_construct_t parameter is passed by value, this constructor is selected over the single-parameter forwarding constructor when the parameter is of type default_construct_t.
+	double_ref_counter(default_construct_t) : front_end(external_counter{Allocator::template create<internal_counter>(), 0}) {}		//Since the default_construct_t parameter is passed by value, this constructor is selected over the single-parameter forwarding constructor when the parameter is of type default_construct_t.
 	
 	//Forwarding Constructors
 	//Cannot forward only a double_ref_counter.  Otherwise, there would be conflict with the copy and move constructors.  Also implicitly cannot forward only a default_construct_t.
 	template <class Arg, class = std::enable_if_t<!std::is_same_v<double_ref_counter, std::remove_cv_t<std::remove_reference_t<Arg>>>>>
-	double_ref_counter(Arg&& arg) : front_end(external_counter{new internal_counter(std::forward<Arg>(arg)), 0}) {}
+	double_ref_counter(Arg&& arg) : front_end(external_counter{Allocator::template create<internal_counter>(std::forward<Arg>(arg)), 0}) {}
 	template <class... Args, class = std::enable_if_t<sizeof...(Args) >= 2>>
-	double_ref_counter(Args&&... args) : front_end(external_counter{new internal_counter(std::forward<Args>(args)...), 0}) {}
+	double_ref_counter(Args&&... args) : front_end(external_counter{Allocator::template create<internal_counter>(std::forward<Args>(args)...), 0}) {}
 	
 	//Copy/Move Constructors and Destructor
 	double_ref_counter(const double_ref_counter& other);
@@ -59,6 +64,7 @@ public:
 	counted_ptr obtain() const;
 	template <class... Args> void replace(Args&&... args);
 	template <class... Args> bool try_replace(const counted_ptr& expected, Args&&... args);
+	bool try_assign(const counted_ptr& expected, const double_ref_counter& other);
 	void erase();
 	
 private:
@@ -75,18 +81,18 @@ private:
 	
 };
 
-template <class T>
-double_ref_counter<T>::double_ref_counter(const double_ref_counter& other) : front_end(external_counter{nullptr, 0}){
+template <class T, class Allocator>
+double_ref_counter<T, Allocator>::double_ref_counter(const double_ref_counter& other) : front_end(external_counter{nullptr, 0}){
 	*this = other;
 }
 
-template <class T>
-double_ref_counter<T>::double_ref_counter(double_ref_counter&& other) : front_end(external_counter{nullptr, 0}){
+template <class T, class Allocator>
+double_ref_counter<T, Allocator>::double_ref_counter(double_ref_counter&& other) : front_end(external_counter{nullptr, 0}){
 	*this = std::move(other);
 }
 
-template <class T>
-double_ref_counter<T>& double_ref_counter<T>::operator=(const double_ref_counter& other){
+template <class T, class Allocator>
+double_ref_counter<T, Allocator>& double_ref_counter<T, Allocator>::operator=(const double_ref_counter& other){
 	counted_ptr other_ref = other.obtain();		//This call to obtain ensures that the other counter's internal_counter won't fall out of scope while copying.
 	if(other_ref.counted_internals != nullptr){
 		other_ref.counted_internals->attach();
@@ -100,8 +106,8 @@ double_ref_counter<T>& double_ref_counter<T>::operator=(const double_ref_counter
 	return *this;
 }
 
-template <class T>
-double_ref_counter<T>& double_ref_counter<T>::operator=(double_ref_counter&& other){
+template <class T, class Allocator>
+double_ref_counter<T, Allocator>& double_ref_counter<T, Allocator>::operator=(double_ref_counter&& other){
 	external_counter other_front_end = other.front_end.load();	//memory order?
 	while(!other.front_end.compare_exchange_weak(other_front_end, external_counter{nullptr, 0})){}	//memory order?
 	
@@ -113,8 +119,8 @@ double_ref_counter<T>& double_ref_counter<T>::operator=(double_ref_counter&& oth
 	return *this;
 }
 
-template <class T>
-typename double_ref_counter<T>::counted_ptr double_ref_counter<T>::obtain() const{
+template <class T, class Allocator>
+typename double_ref_counter<T, Allocator>::counted_ptr double_ref_counter<T, Allocator>::obtain() const{
 	external_counter old_front_end = front_end.load(), new_front_end;		//memory order?
 	do{
 		new_front_end = old_front_end;	//Note that if CAS fails below, old_front_end will change to the actual value.
@@ -123,28 +129,28 @@ typename double_ref_counter<T>::counted_ptr double_ref_counter<T>::obtain() cons
 	return counted_ptr(new_front_end.internals);
 }
 
-template <class T>
+template <class T, class Allocator>
 template <class... Args>
-void double_ref_counter<T>::replace(Args&&... args){
-	external_counter old_front_end = front_end.load(), new_front_end{new internal_counter(std::forward<Args>(args)...), 0};	//memory order?
+void double_ref_counter<T, Allocator>::replace(Args&&... args){
+	external_counter old_front_end = front_end.load(), new_front_end{Allocator::template create<internal_counter>(std::forward<Args>(args)...), 0};	//memory order?
 	while(!front_end.compare_exchange_weak(old_front_end, new_front_end)){}	//need to ensure that the new_front_end was actually initialized before this CAS, memory order?
 	if(old_front_end.internals != nullptr){
 		old_front_end.internals->detach(old_front_end.ex_count);
 	}
 }
 
-template <class T>
+template <class T, class Allocator>
 template <class... Args>
-bool double_ref_counter<T>::try_replace(const counted_ptr& expected, Args&&... args){
+bool double_ref_counter<T, Allocator>::try_replace(const counted_ptr& expected, Args&&... args){
 	external_counter old_front_end = front_end.load();	//memory order?
 	if(old_front_end.internals != expected.counted_internals){
 		return false;
 	}
 	
-	external_counter new_front_end{new internal_counter(std::forward<Args>(args)...), 0};
+	external_counter new_front_end{Allocator::template create<internal_counter>(std::forward<Args>(args)...), 0};
 	while(!front_end.compare_exchange_weak(old_front_end, new_front_end)){	//memory order?
 		if(old_front_end.internals != expected.counted_internals){
-			delete new_front_end.internals;
+			Allocator::destroy(new_front_end.internals);
 			return false;
 		}
 	}
@@ -154,8 +160,30 @@ bool double_ref_counter<T>::try_replace(const counted_ptr& expected, Args&&... a
 	return true;
 }
 
-template <class T>
-void double_ref_counter<T>::erase(){
+template <class T, class Allocator>
+bool double_ref_counter<T, Allocator>::try_assign(const counted_ptr& expected, const double_ref_counter& other){
+	counted_ptr other_ref = other.obtain();		//Like operator=, this keeps the other counter's internal_counter alive while we attach to it.
+	if(other_ref.counted_internals != nullptr){
+		other_ref.counted_internals->attach();
+	}
+	
+	external_counter old_front_end = front_end.load();	//memory order?
+	do{
+		if(old_front_end.internals != expected.counted_internals){
+			if(other_ref.counted_internals != nullptr){
+				other_ref.counted_internals->detach(0);	//Undo the attach, other_ref still observes the internals so they can't be deleted here.
+			}
+			return false;
+		}
+	}while(!front_end.compare_exchange_weak(old_front_end, external_counter{other_ref.counted_internals, 0}));	//memory order?
+	if(old_front_end.internals != nullptr){
+		old_front_end.internals->detach(old_front_end.ex_count);
+	}
+	return true;
+}
+
+template <class T, class Allocator>
+void double_ref_counter<T, Allocator>::erase(){
 	external_counter old_front_end = front_end.load();		//memory order?
 	while(!front_end.compare_exchange_weak(old_front_end, external_counter{nullptr, 0})){}	//memory order?
 	if(old_front_end.internals != nullptr){
@@ -166,8 +194,8 @@ void double_ref_counter<T>::erase(){
 /*
  * The internal counter for the double-counting reference counter.
  */
-template <class T>
-class double_ref_counter<T>::internal_counter{
+template <class T, class Allocator>
+class double_ref_counter<T, Allocator>::internal_counter{
 public:
 	
 	//Constructors/Destructor
@@ -189,7 +217,7 @@ public:
 	
 private:
 	
-	friend double_ref_counter<T>::counted_ptr;
+	friend double_ref_counter<T, Allocator>::counted_ptr;
 	
 	//Private Types
 	struct internal_counts{
@@ -203,20 +231,20 @@ private:
 	
 };
 
-template <class T>
-void double_ref_counter<T>::internal_counter::release(){
+template <class T, class Allocator>
+void double_ref_counter<T, Allocator>::internal_counter::release(){
 	internal_counts old_counters = counters.load(), new_counters;	//memory order?
 	do{
 		new_counters = old_counters;
 		++(new_counters.in_count);
 	}while(!counters.compare_exchange_weak(old_counters, new_counters));	//memory order?
 	if(new_counters.referrers == 0 && new_counters.in_count == 0){
-		delete this;
+		Allocator::destroy(this);
 	}
 }
 
-template <class T>
-void double_ref_counter<T>::internal_counter::attach(){
+template <class T, class Allocator>
+void double_ref_counter<T, Allocator>::internal_counter::attach(){
 	internal_counts old_counters = counters.load(), new_counters;	//memory order?
 	do{
 		new_counters = old_counters;
@@ -224,8 +252,8 @@ void double_ref_counter<T>::internal_counter::attach(){
 	}while(!counters.compare_exchange_weak(old_counters, new_counters));	//memory order?
 }
 
-template <class T>
-void double_ref_counter<T>::internal_counter::detach(unsigned int observers){
+template <class T, class Allocator>
+void double_ref_counter<T, Allocator>::internal_counter::detach(unsigned int observers){
 	internal_counts old_counters = counters.load(), new_counters;	//memory order?
 	do{
 		new_counters = old_counters;
@@ -233,7 +261,7 @@ void double_ref_counter<T>::internal_counter::detach(unsigned int observers){
 		new_counters.in_count -= observers;
 	}while(!counters.compare_exchange_weak(old_counters, new_counters));	//memory order?
 	if(new_counters.referrers == 0 && new_counters.in_count == 0){
-		delete this;
+		Allocator::destroy(this);
 	}
 }
 
@@ -241,8 +269,8 @@ void double_ref_counter<T>::internal_counter::detach(unsigned int observers){
  * The RAII class protecting access to an internal counter object.
  * This object is not thread-safe, and should not be shared between threads.
  */
-template <class T>
-class double_ref_counter<T>::counted_ptr{
+template <class T, class Allocator>
+class double_ref_counter<T, Allocator>::counted_ptr{
 public:
 	
 	//Constructors/Destructor
@@ -265,20 +293,20 @@ public:
 	
 	//Mutable Accessors
 	//Disabled if value_type is const (with SFINAE).  Mutating data with these functions is not thread-safe unless the underlying data structure is thread-safe.
-	template <class = std::enable_if_t<std::is_same_v<value_type, std::remove_const_t<value_type>>>> value_type& operator*() {return counted_internals->data;}
-	template <class = std::enable_if_t<std::is_same_v<value_type, std::remove_const_t<value_type>>>> value_type* operator->() {return &(counted_internals->data);}
+	template <class U = value_type, class = std::enable_if_t<std::is_same_v<U, std::remove_const_t<U>>>> U& operator*() {return counted_internals->data;}
+	template <class U = value_type, class = std::enable_if_t<std::is_same_v<U, std::remove_const_t<U>>>> U* operator->() {return &(counted_internals->data);}
 	
 private:
 	
-	friend double_ref_counter<T>;
+	friend double_ref_counter<T, Allocator>;
 	
 	//Data Members
 	internal_counter* counted_internals;
 	
 };
 
-template <class T>
-typename double_ref_counter<T>::counted_ptr& double_ref_counter<T>::counted_ptr::operator=(counted_ptr&& other){
+template <class T, class Allocator>
+typename double_ref_counter<T, Allocator>::counted_ptr& double_ref_counter<T, Allocator>::counted_ptr::operator=(counted_ptr&& other){
 	if(counted_internals != nullptr){
 		counted_internals->release();
 	}
@@ -0,0 +1,406 @@
+#ifndef LOCKFREE_EPOCH_H_INCLUDED
+#define LOCKFREE_EPOCH_H_INCLUDED
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "double_ref_counter.hpp"
+
+namespace lockfree{
+
+/*
+ * An epoch-based memory reclamation domain.
+ *
+ * Threads pin the domain's current epoch while they access shared nodes,
+ * and nodes which have been unlinked are retired rather than deleted.  A
+ * retired node is only deleted once the epoch has advanced twice since it
+ * was retired, at which point no pinned thread can still see it.
+ *
+ * Every thread gets its own record in each domain it uses.  Pinning only
+ * writes to the calling thread's record, so readers never write to memory
+ * shared with other threads.  Domains must outlive any use of them, but
+ * threads may outlive domains.
+ */
+class epoch_domain{
+public:
+	
+	//Constructors/Destructor
+	epoch_domain();
+	epoch_domain(const epoch_domain&) = delete;
+	epoch_domain(epoch_domain&&) = delete;
+	~epoch_domain();
+	
+	//Assignment Operators
+	epoch_domain& operator=(const epoch_domain&) = delete;
+	epoch_domain& operator=(epoch_domain&&) = delete;
+	
+	//Member Functions
+	void pin();
+	void unpin();
+	template <class T, class Allocator = new_allocator> void retire(T* ptr);
+	
+private:
+	
+	//Private Types
+	struct retired_node{
+		void* ptr;
+		void (*deleter)(void*);
+		unsigned long retired_epoch;
+	};
+	struct alignas(64) thread_record{	//Aligned so that records of different threads don't share a cache line.
+		std::atomic<unsigned long> state;	//Zero if unpinned, otherwise the pinned epoch shifted left once with the low bit set.
+		std::atomic<bool> in_use;
+		unsigned int pins;
+		std::vector<retired_node> retired;
+		std::size_t reclaim_at;	//Grows with whatever couldn't be reclaimed last time, so reclaiming stays amortized constant.
+		thread_record* next;
+	};
+	class thread_cache;
+	
+	//Data Members
+	const unsigned long id;	//Unlike addresses, ids are never reused, so a thread can tell if a domain it used has been destroyed.
+	std::atomic<unsigned long> global_epoch;
+	std::atomic<thread_record*> records;
+	
+	//Static Data Members
+	static constexpr std::size_t reclaim_threshold = 64;
+	
+	//Private Member Functions
+	thread_record& local_record();
+	thread_record& acquire_record();
+	bool try_advance();
+	void reclaim(thread_record& rec);
+	
+	//Private Static Member Functions
+	static unsigned long next_id();
+	static std::mutex& live_domains_mutex();
+	static std::vector<unsigned long>& live_domains();
+	
+};
+
+/*
+ * The records a thread has acquired in each domain it has used.
+ * When the thread exits, its records are given up (along with any
+ * garbage not yet reclaimed) to be adopted by other threads.
+ */
+class epoch_domain::thread_cache{
+public:
+	
+	//Public Types
+	struct entry{
+		unsigned long domain_id;
+		epoch_domain* domain;
+		thread_record* rec;
+	};
+	
+	//Constructors/Destructor
+	thread_cache() : last{0, nullptr, nullptr}, entries() {}
+	thread_cache(const thread_cache&) = delete;
+	thread_cache(thread_cache&&) = delete;
+	~thread_cache();
+	
+	//Assignment Operators
+	thread_cache& operator=(const thread_cache&) = delete;
+	thread_cache& operator=(thread_cache&&) = delete;
+	
+	//Data Members
+	entry last;	//Most threads only use one domain, so remember the last one used.
+	std::vector<entry> entries;
+	
+};
+
+inline epoch_domain::thread_cache::~thread_cache(){
+	std::unique_lock lk(live_domains_mutex());	//Keeps the domains from being destroyed while their records are given up.
+	std::vector<unsigned long>& live = live_domains();
+	for(auto i = entries.begin(); i != entries.end(); ++i){
+		if(std::find(live.begin(), live.end(), i->domain_id) != live.end()){
+			i->domain->reclaim(*(i->rec));
+			i->rec->in_use.store(false);
+		}
+	}
+}
+
+inline epoch_domain::epoch_domain() : id(next_id()), global_epoch(0), records(nullptr){
+	std::unique_lock lk(live_domains_mutex());
+	live_domains().push_back(id);
+}
+
+inline epoch_domain::~epoch_domain(){
+	{
+		std::unique_lock lk(live_domains_mutex());
+		std::vector<unsigned long>& live = live_domains();
+		live.erase(std::find(live.begin(), live.end(), id));
+	}
+	
+	thread_record* rec = records.load();
+	while(rec != nullptr){	//Nobody is using the domain anymore, so everything can be deleted.
+		for(auto i = rec->retired.begin(); i != rec->retired.end(); ++i){
+			i->deleter(i->ptr);
+		}
+		thread_record* next = rec->next;
+		delete rec;
+		rec = next;
+	}
+}
+
+inline void epoch_domain::pin(){
+	thread_record& rec = local_record();
+	if(rec.pins++ == 0){
+		rec.state.store((global_epoch.load() << 1) | 1);	//Must be visible before any shared node is read, hence sequentially consistent.
+	}
+}
+
+inline void epoch_domain::unpin(){
+	thread_record& rec = local_record();
+	if(--rec.pins == 0){
+		rec.state.store(0, std::memory_order_release);
+	}
+}
+
+template <class T, class Allocator>
+void epoch_domain::retire(T* ptr){
+	thread_record& rec = local_record();
+	rec.retired.push_back(retired_node{const_cast<std::remove_const_t<T>*>(ptr), [](void* p){Allocator::destroy(static_cast<T*>(p));}, global_epoch.load()});
+	if(rec.retired.size() >= rec.reclaim_at){
+		try_advance();
+		reclaim(rec);
+		rec.reclaim_at = std::max(reclaim_threshold, 2 * rec.retired.size());
+	}
+}
+
+inline epoch_domain::thread_record& epoch_domain::local_record(){
+	static thread_local thread_cache cache;
+	if(cache.last.domain_id == id){
+		return *(cache.last.rec);
+	}
+	
+	for(auto i = cache.entries.begin(); i != cache.entries.end(); ++i){
+		if(i->domain_id == id){
+			cache.last = *i;
+			return *(i->rec);
+		}
+	}
+	cache.entries.push_back(thread_cache::entry{id, this, &acquire_record()});
+	cache.last = cache.entries.back();
+	return *(cache.last.rec);
+}
+
+inline epoch_domain::thread_record& epoch_domain::acquire_record(){
+	for(thread_record* r = records.load(); r != nullptr; r = r->next){	//Records are only freed with the domain, so threads which have exited leave theirs to be adopted.
+		bool expected = false;
+		if(!r->in_use.load() && r->in_use.compare_exchange_strong(expected, true)){
+			return *r;
+		}
+	}
+	
+	thread_record* rec = new thread_record{{0}, {true}, 0, {}, reclaim_threshold, records.load()};
+	while(!records.compare_exchange_weak(rec->next, rec)){}	//memory order?
+	return *rec;
+}
+
+inline bool epoch_domain::try_advance(){
+	unsigned long current = global_epoch.load();
+	for(thread_record* r = records.load(); r != nullptr; r = r->next){
+		unsigned long s = r->state.load();
+		if((s & 1) && (s >> 1) != current){
+			return false;	//Someone is still pinned in an older epoch.
+		}
+	}
+	return global_epoch.compare_exchange_strong(current, current + 1);
+}
+
+inline void epoch_domain::reclaim(thread_record& rec){
+	unsigned long current = global_epoch.load();
+	auto still_visible = std::partition(rec.retired.begin(), rec.retired.end(), [current](const retired_node& n){return n.retired_epoch + 2 > current;});
+	std::vector<retired_node> reclaimable(still_visible, rec.retired.end());	//Deleters may retire more nodes, so don't delete straight out of the vector.
+	rec.retired.erase(still_visible, rec.retired.end());
+	for(auto i = reclaimable.begin(); i != reclaimable.end(); ++i){
+		i->deleter(i->ptr);
+	}
+}
+
+inline unsigned long epoch_domain::next_id(){
+	static std::atomic<unsigned long> ids(1);	//Zero is never handed out, so it can mark an empty thread_cache entry.
+	return ids.fetch_add(1);
+}
+
+inline std::mutex& epoch_domain::live_domains_mutex(){
+	static std::mutex* mu = new std::mutex();	//Never destroyed, since threads may exit after static destruction has begun.
+	return *mu;
+}
+
+inline std::vector<unsigned long>& epoch_domain::live_domains(){
+	static std::vector<unsigned long>* live = new std::vector<unsigned long>();	//Likewise.
+	return *live;
+}
+
+/*
+ * The domain used by epoch_ptr and epoch_guard unless told otherwise.
+ * Other domains can be supplied by any type with a static instance()
+ * function returning an epoch_domain.
+ */
+struct default_epoch_domain{
+	static epoch_domain& instance() {static epoch_domain* domain = new epoch_domain(); return *domain;}	//Never destroyed, for the same reason as above.
+};
+
+/*
+ * RAII class which keeps the calling thread pinned for its lifetime.
+ */
+template <class Domain = default_epoch_domain>
+class epoch_guard{
+public:
+	
+	//Constructors/Destructor
+	epoch_guard() {Domain::instance().pin();}
+	epoch_guard(const epoch_guard&) = delete;
+	epoch_guard(epoch_guard&&) = delete;
+	~epoch_guard() {Domain::instance().unpin();}
+	
+	//Assignment Operators
+	epoch_guard& operator=(const epoch_guard&) = delete;
+	epoch_guard& operator=(epoch_guard&&) = delete;
+	
+};
+
+/*
+ * An atomic owning pointer whose old values are retired to an epoch domain.
+ *
+ * Offers the same operations as a double_ref_counter, but obtain() is
+ * a plain load.  The guarded_ptrs it hands out are only valid while the
+ * calling thread is pinned.  Data is made and destroyed through the
+ * Allocator policy.
+ */
+template <class T, class Domain = default_epoch_domain, class Allocator = new_allocator>
+class epoch_ptr{
+public:
+	
+	//Public Types
+	using value_type = T;
+	class guarded_ptr;
+	using handle = guarded_ptr;
+	
+	//Default and Internal Default Constructors
+	epoch_ptr() : ptr(nullptr), owning(true) {}
+	epoch_ptr(default_construct_t) : ptr(Allocator::template create<value_type>()), owning(true) {}
+	
+	//Forwarding Constructors
+	//Same restrictions as the double_ref_counter's forwarding constructors.
+	template <class Arg, class = std::enable_if_t<!std::is_same_v<epoch_ptr, std::remove_cv_t<std::remove_reference_t<Arg>>>>>
+	epoch_ptr(Arg&& arg) : ptr(Allocator::template create<value_type>(std::forward<Arg>(arg))), owning(true) {}
+	template <class... Args, class = std::enable_if_t<sizeof...(Args) >= 2>>
+	epoch_ptr(Args&&... args) : ptr(Allocator::template create<value_type>(std::forward<Args>(args)...)), owning(true) {}
+	
+	//Copy/Move Constructors and Destructor
+	epoch_ptr(const epoch_ptr&) = delete;	//Epoch pointers are the sole owners of their data.
+	epoch_ptr(epoch_ptr&& other) : ptr(other.ptr.exchange(nullptr)), owning(other.owning) {}
+	~epoch_ptr() {if(owning){Allocator::destroy(ptr.load());}}	//Nobody else can see this pointer anymore, so there's no need to retire.
+	
+	//Assignment Operators
+	epoch_ptr& operator=(const epoch_ptr&) = delete;
+	epoch_ptr& operator=(epoch_ptr&& other);
+	
+	//Member Functions
+	guarded_ptr obtain() const {return guarded_ptr(ptr.load());}	//memory order?
+	template <class... Args> void replace(Args&&... args);
+	template <class... Args> bool try_replace(const guarded_ptr& expected, Args&&... args);
+	bool try_assign(const guarded_ptr& expected, epoch_ptr& other);
+	void erase();
+	
+private:
+	
+	//Data Members
+	std::atomic<value_type*> ptr;
+	bool owning;	//Only false once another epoch_ptr has taken over this one's data, see try_assign.
+	
+	//Private Member Functions
+	void retire_old(value_type* old) {if(old != nullptr && owning){Domain::instance().template retire<value_type, Allocator>(old);}}
+	
+};
+
+template <class T, class Domain, class Allocator>
+epoch_ptr<T, Domain, Allocator>& epoch_ptr<T, Domain, Allocator>::operator=(epoch_ptr&& other){
+	retire_old(ptr.exchange(other.ptr.exchange(nullptr)));	//memory order?
+	owning = other.owning;
+	return *this;
+}
+
+template <class T, class Domain, class Allocator>
+template <class... Args>
+void epoch_ptr<T, Domain, Allocator>::replace(Args&&... args){
+	retire_old(ptr.exchange(Allocator::template create<value_type>(std::forward<Args>(args)...)));	//memory order?
+}
+
+template <class T, class Domain, class Allocator>
+template <class... Args>
+bool epoch_ptr<T, Domain, Allocator>::try_replace(const guarded_ptr& expected, Args&&... args){
+	value_type* old_ptr = ptr.load();	//memory order?
+	if(old_ptr != expected.guarded){
+		return false;
+	}
+	
+	value_type* new_ptr = Allocator::template create<value_type>(std::forward<Args>(args)...);
+	if(!ptr.compare_exchange_strong(old_ptr, new_ptr)){	//memory order?
+		Allocator::destroy(new_ptr);
+		return false;
+	}
+	retire_old(old_ptr);
+	return true;
+}
+
+/*
+ * Takes over other's data if this pointer still holds expected.
+ * Other keeps pointing at the data but no longer owns it, so it must
+ * not be modified afterwards (it's meant to belong to a node which is
+ * being unlinked).
+ */
+template <class T, class Domain, class Allocator>
+bool epoch_ptr<T, Domain, Allocator>::try_assign(const guarded_ptr& expected, epoch_ptr& other){
+	value_type* old_ptr = expected.guarded;
+	if(!ptr.compare_exchange_strong(old_ptr, other.ptr.load())){	//memory order?
+		return false;
+	}
+	other.owning = false;	//Happens before old_ptr is retired, so before other's owner (if it's old_ptr) can be deleted.
+	retire_old(old_ptr);
+	return true;
+}
+
+template <class T, class Domain, class Allocator>
+void epoch_ptr<T, Domain, Allocator>::erase(){
+	retire_old(ptr.exchange(nullptr));	//memory order?
+}
+
+/*
+ * A plain pointer to an epoch_ptr's data, protected by the calling
+ * thread's pin rather than by a reference count.
+ */
+template <class T, class Domain, class Allocator>
+class epoch_ptr<T, Domain, Allocator>::guarded_ptr{
+public:
+	
+	//Constructors/Destructor
+	guarded_ptr(value_type* p = nullptr) : guarded(p) {}
+	
+	//Properties Functions
+	bool has_data() const {return guarded != nullptr;}
+	
+	//Accessors
+	//Can throw nullptr exceptions.  Constness follows value_type, as with double_ref_counter::counted_ptr.
+	value_type& operator*() const {return *guarded;}
+	value_type* operator->() const {return guarded;}
+	
+private:
+	
+	friend epoch_ptr<T, Domain, Allocator>;
+	
+	//Data Members
+	value_type* guarded;
+	
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,403 @@
+#ifndef LOCKFREE_FLAT_HASH_TABLE_H_INCLUDED
+#define LOCKFREE_FLAT_HASH_TABLE_H_INCLUDED
+
+#include <cmath>
+#include <atomic>
+#include <limits>
+#include <new>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include "reclamation.hpp"
+#include "../hashing/sizing.hpp"
+
+namespace lockfree{
+
+/*
+ * A thread-safe lockfree hash table data structure which stores its
+ * keys and values inline, for trivially copyable key and value types.
+ *
+ * Each cell is claimed by a single-word CAS on its key (which starts
+ * out as the table's empty key), and its value is updated atomically
+ * alongside a few state bits.  Hence writes don't allocate, and probing
+ * walks contiguous memory.  Resizing, migration, tombstone compaction
+ * and reclamation work the same way as in lockfree::hash_table.
+ *
+ * The empty key can never be stored in the table (it marks a cell as
+ * unclaimed), so setting or removing it throws std::invalid_argument.
+ */
+template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>, class Reclaimer = epoch_reclaimed<>, class Sizing = hashing::modulo_sizing>
+class flat_hash_table{
+public:
+	
+	static_assert(std::is_trivially_copyable_v<K>, "flat_hash_table keys must be trivially copyable.");
+	static_assert(std::is_trivially_copyable_v<V>, "flat_hash_table values must be trivially copyable.");
+	
+	//Public Types
+	using size_type = unsigned int;
+	using key_type = K;
+	using value_type = V;
+	using hasher = Hash;
+	using comparer = Compare;
+	
+	//Constructors/Destructor
+	flat_hash_table(size_type s = 1, const key_type& empty = default_empty_key()) : empty_key(empty), definitive_table(s >= 1 ? s : 1, empty) {}
+	flat_hash_table(shared_copy_source<flat_hash_table, Reclaimer> other) : empty_key(other.empty_key), definitive_table(other.definitive_table) {}	//Shallow copy, for reference counted tables only.
+	flat_hash_table(flat_hash_table&& other) : empty_key(other.empty_key), definitive_table(std::move(other.definitive_table)) {}
+	~flat_hash_table() = default;
+	
+	//Assignment Operators
+	flat_hash_table& operator=(shared_copy_source<flat_hash_table, Reclaimer> other) {empty_key = other.empty_key; definitive_table = other.definitive_table; return *this;}	//Likewise.
+	flat_hash_table& operator=(flat_hash_table&& other) {empty_key = other.empty_key; definitive_table = std::move(other.definitive_table); return *this;}
+	
+	//Member Functions
+	bool get(const key_type& key, value_type& ret_value) const;	//Never finds the empty key.
+	void set(const key_type& key, const value_type& value) {generic_set(key, value, false);}
+	void remove(const key_type& key) {generic_set(key, value_type(), true);}
+	
+	//Static Member Functions
+	static key_type default_empty_key() {return std::numeric_limits<key_type>::max();}	//Only usable with arithmetic keys, others must supply an empty key.
+	
+private:
+	
+	//Private Types
+	class table;
+	template <class T> using pointer = typename Reclaimer::template pointer<T>;
+	
+	//Data Members
+	key_type empty_key;
+	pointer<table> definitive_table;
+	
+	//Static Data Members
+	static constexpr size_type migration_batch = 16;
+	
+	//Private Member Functions
+	void generic_set(const key_type& key, const value_type& value, bool is_tombstone);
+	void help_migrate();
+	static void migrate_cell(table& from, size_type i);
+	
+};
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+bool flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::get(const key_type& key, value_type& ret_value) const{
+	typename Reclaimer::guard pin;	//Reads leave migrating to the writers, so that with epochs they only load shared memory.
+	
+	bool success = false, ret_tombstone = true;
+	typename pointer<table>::handle tbl = definitive_table.obtain();
+	while(tbl.has_data()){
+		if(tbl->get(key, ret_value, ret_tombstone)){
+			success = !ret_tombstone;	//Always uses the last occurrance of the key as the definitive answer.
+		}
+		tbl = std::move(tbl->next.obtain());
+	}
+	return success;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::generic_set(const key_type& key, const value_type& value, bool is_tombstone){
+	if(comparer()(key, empty_key)){
+		throw std::invalid_argument("flat_hash_table: the empty key can't be set or removed");	//Claiming its cell would be a CAS from empty to empty, leaving a live value which looks unclaimed.
+	}
+	typename Reclaimer::guard pin;
+	help_migrate();
+	
+	while(true){
+		bool older_live = false, ret_tombstone = true;
+		value_type unused;
+		typename pointer<table>::handle tbl = definitive_table.obtain();
+		if(!tbl.has_data()){
+			definitive_table.try_replace(tbl, 1, empty_key);	//Failure implies someone else made it non-null.
+			tbl = definitive_table.obtain();
+		}
+		
+		typename pointer<table>::handle next_tbl = tbl->next.obtain();
+		bool migrating = next_tbl.has_data();
+		while(next_tbl.has_data()){	//Find the newest table.  Tombstones need to know if an older table still holds a live copy of the key.
+			if(is_tombstone && tbl->get(key, unused, ret_tombstone)){
+				older_live = !ret_tombstone;
+			}
+			tbl = std::move(next_tbl);
+			next_tbl = tbl->next.obtain();
+		}
+		
+		typename table::set_result result = tbl->set(key, value, is_tombstone, !is_tombstone || older_live, true);	//Tombstones are only inserted when they have to hide an older live copy.
+		if(result == table::set_result::failure){
+			tbl->next.try_replace(next_tbl, tbl->successor_size(), empty_key);	//Failure implies someone else made it non-null.
+		}else if(result != table::set_result::frozen){
+			if(is_tombstone && !migrating && tbl->compaction_due()){	//Compacting during a migration would only lengthen the chain, and the migration drops the oldest table's tombstones anyway.
+				tbl->next.try_replace(next_tbl, tbl->size, empty_key);	//Migrating into a table of the same size drops the tombstones.
+			}
+			break;	//If the newest table was frozen, a newer table has been appended since we looked.  Otherwise we're done.
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::help_migrate(){
+	typename pointer<table>::handle oldest = definitive_table.obtain();
+	if(!oldest.has_data()){
+		return;
+	}
+	typename pointer<table>::handle newer = oldest->next.obtain();
+	if(!newer.has_data()){
+		return;	//Only one table, nothing to migrate.
+	}
+	
+	size_type start = oldest->migration_claimed.load(), end;	//memory order?
+	do{
+		if(start >= oldest->size){
+			return;	//Every batch has been claimed, whoever claimed the last one will unlink the table.
+		}
+		end = std::min(oldest->size, start + migration_batch);
+	}while(!oldest->migration_claimed.compare_exchange_weak(start, end));	//memory order?
+	
+	for(size_type i = start; i < end; ++i){
+		migrate_cell(*oldest, i);
+	}
+	if(oldest->migration_completed.fetch_add(end - start) + (end - start) == oldest->size){	//memory order?
+		definitive_table.try_assign(oldest, oldest->next);	//Only the thread completing the migration unlinks the table, so this shouldn't fail.
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::migrate_cell(table& from, size_type i){
+	typename table::cell& c = from.cells[i];
+	typename table::cell_data old_data = c.data.load();	//memory order?
+	do{
+		if(old_data.state & table::frozen_flag){
+			return;
+		}
+	}while(!c.data.compare_exchange_weak(old_data, typename table::cell_data{old_data.value, static_cast<unsigned char>(old_data.state | table::frozen_flag)}));	//Freezing the cell means no writer can update it after we copy it.  memory order?
+	if(old_data.state != table::live_flag){
+		return;	//Vacant cells and tombstones don't need to be carried forward, newer tables hide older ones anyways.
+	}
+	
+	key_type key = c.key.load();	//A cell's key is always claimed before its value is set.  memory order?
+	typename pointer<table>::handle tbl = from.next.obtain();
+	while(true){
+		typename table::set_result result = tbl->set(key, old_data.value, false, true, false);	//Never overwrite, newer tables always have newer values.
+		if(result != table::set_result::failure && result != table::set_result::frozen){
+			return;
+		}
+		
+		typename pointer<table>::handle next_tbl = tbl->next.obtain();
+		if(!next_tbl.has_data()){
+			tbl->next.try_replace(next_tbl, tbl->successor_size(), tbl->empty_key);	//Again, failure implies someone else made it non-null.
+			next_tbl = tbl->next.obtain();
+		}
+		tbl = std::move(next_tbl);
+	}
+}
+
+/*
+ * The actual data structure which contains the cells.
+ * Meant to be used as a component of the flat_hash_table object.
+ */
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+class flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table{
+public:
+	
+	//Public Types
+	enum struct set_result{
+		failure,
+		update,
+		insert,
+		absent,		//The key wasn't found, and inserting wasn't allowed.
+		present,	//The key was found, and updating wasn't allowed.
+		frozen,		//The key's cell has been migrated, so the key belongs in a newer table.
+	};
+	
+	//Constructors/Destructor
+	table() = delete;
+	table(size_type s, const key_type& empty);
+	table(const table&) = delete;
+	table(table&&) = delete;
+	~table();
+	
+	//Assignment Operators
+	table& operator=(const table&) = delete;
+	table& operator=(table&&) = delete;
+	
+	//Member Functions
+	bool get(const key_type& key, value_type& ret_value, bool& ret_tombstone) const;
+	set_result set(const key_type& key, const value_type& value, bool is_tombstone, bool can_insert, bool can_update);
+	
+private:
+	
+	friend flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>;
+	
+	//Private Types
+	struct cell_data{
+		value_type value;
+		unsigned char state;	//Zero when vacant (the key may or may not have been claimed yet), otherwise some combination of the flags below.
+	};
+	struct cell{
+		std::atomic<key_type> key;
+		std::atomic<cell_data> data;
+	};
+	struct counters{
+		size_type elements;
+		size_type inserters_and_flag;	//Flag is wrapped up in here so this struct is not paddded to an irregular (non power-of-two) size.
+		
+		static constexpr size_type resize_flag_mask = 1 << (8 * sizeof(size_type) - 1);
+		static constexpr size_type inserters_mask = ~resize_flag_mask;
+	};
+	
+	//Immutable Data Members
+	const size_type size;
+	const size_type capacity;
+	const key_type empty_key;
+	
+	//Atomic Data Members
+	std::atomic<counters> table_counters;
+	std::atomic<size_type> migration_claimed;	//Cells [0, migration_claimed) have been claimed by a migrating thread.
+	std::atomic<size_type> migration_completed;	//Number of cells which have been frozen (and copied forward if need be).
+	std::atomic<size_type> tombstones;	//Number of cells currently holding a tombstone.  Only a hint for compaction.
+	
+	//Table Data Members
+	pointer<table> next;
+	cell* const cells;	//This is a const pointer, not a pointer to const data.
+	
+	//Static Data Members
+	static constexpr double capacity_percentage = 0.7;
+	static constexpr size_type resize_factor = 2;
+	static constexpr std::size_t cache_line_size = 64;
+	static constexpr unsigned char live_flag = 1;
+	static constexpr unsigned char tombstone_flag = 2;
+	static constexpr unsigned char frozen_flag = 4;
+	
+	//Private Member Functions
+	bool compaction_due() const {return tombstones.load() * 2 >= capacity;}	//memory order?
+	size_type successor_size() const {return compaction_due() ? size : resize_factor * size;}	//A table mostly full of tombstones is rebuilt rather than grown.
+	bool attempt_insert();
+	counters complete_insert(bool success);
+	
+};
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::table(size_type s, const key_type& empty) : size(Sizing::round(s)), capacity(size_type(std::ceil(double(size) * capacity_percentage))), empty_key(empty), table_counters(counters{0, 0}), migration_claimed(0), migration_completed(0), tombstones(0), next(), cells(static_cast<cell*>(::operator new[](size * sizeof(cell), std::align_val_t(cache_line_size)))){
+	for(size_type i = 0; i < size; ++i){	//Cells are trivially destructible, so nothing needs to be undone if this throws.
+		new(cells + i) cell{{empty_key}, {cell_data{value_type(), 0}}};
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::~table(){
+	::operator delete[](cells, std::align_val_t(cache_line_size));
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+bool flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::get(const key_type& key, value_type& ret_value, bool& ret_tombstone) const{
+	size_type index = Sizing::home(hasher()(key), size);
+	for(size_type i = 0; i < size; ++i){
+		const cell& c = cells[Sizing::wrap(index + i, size)];
+		key_type cell_key = c.key.load();	//memory order?
+		if(comparer()(cell_key, empty_key)){
+			return false;
+		}else if(comparer()(cell_key, key)){
+			cell_data data = c.data.load();	//memory order?
+			if(!(data.state & (live_flag | tombstone_flag))){
+				return false;	//The key has been claimed, but its value hasn't been set yet.
+			}
+			ret_value = data.value;
+			ret_tombstone = data.state & tombstone_flag;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::set_result flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::set(const key_type& key, const value_type& value, bool is_tombstone, bool can_insert, bool can_update){
+	bool attempted_insert = false, claimed = false;
+	set_result result = set_result::failure;
+	size_type index = Sizing::home(hasher()(key), size);
+	for(size_type i = 0; i < size; ++i){
+		cell& c = cells[Sizing::wrap(index + i, size)];
+		key_type cell_key = c.key.load();	//memory order?
+		if(comparer()(cell_key, empty_key)){	//Empty cell found, attempt to claim it.
+			if(!can_insert){
+				result = set_result::absent;
+				break;
+			}
+			if(!attempted_insert){
+				if(!(attempted_insert = attempt_insert())){
+					break;
+				}
+			}
+			if(!c.key.compare_exchange_strong(cell_key, key)){	//memory order?
+				--i;	//Repeat the process.  Someone else claimed the cell.
+				continue;
+			}
+			claimed = true;
+		}else if(!comparer()(cell_key, key)){
+			continue;
+		}
+		
+		//The cell belongs to our key, so set its value (whether we just claimed it or not).
+		cell_data old_data = c.data.load();	//memory order?
+		bool vacant;
+		do{
+			vacant = !(old_data.state & (live_flag | tombstone_flag));
+			if(old_data.state & frozen_flag){
+				result = set_result::frozen;
+			}else if(vacant && !can_insert){
+				result = set_result::absent;
+			}else if(!vacant && !can_update){
+				result = set_result::present;
+			}else{
+				continue;
+			}
+			break;
+		}while(!c.data.compare_exchange_weak(old_data, cell_data{value, is_tombstone ? tombstone_flag : live_flag}));	//A CAS rather than a store, so a frozen cell is never written to.  memory order?
+		if(result == set_result::failure){
+			result = vacant ? set_result::insert : set_result::update;
+			if(is_tombstone != bool(old_data.state & tombstone_flag)){
+				is_tombstone ? tombstones.fetch_add(1) : tombstones.fetch_sub(1);	//memory order?
+			}
+		}
+		break;
+	}
+	if(attempted_insert){	//This is a little brittle, could use an RAII class or a try-catch block.
+		complete_insert(claimed);	//A claimed cell is used up even if its value couldn't be set.
+	}
+	return result;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+bool flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::attempt_insert(){
+	counters old_counters = table_counters.load(), new_counters;	//memory order?
+	do{
+		new_counters = old_counters;
+		if(new_counters.inserters_and_flag & counters::resize_flag_mask){
+			return false;
+		}
+		++(new_counters.inserters_and_flag);	//Increment may overflow into the flag bit.
+		if(new_counters.elements + (new_counters.inserters_and_flag & counters::inserters_mask) == capacity){	//Overflow is rectified here by taking everything except the flag bit.
+			new_counters.inserters_and_flag = counters::resize_flag_mask | (new_counters.inserters_and_flag & counters::inserters_mask);
+		}else{
+			new_counters.inserters_and_flag = new_counters.inserters_and_flag & counters::inserters_mask;
+		}
+	}while(!table_counters.compare_exchange_weak(old_counters, new_counters));	//memory order?
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::counters flat_hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::complete_insert(bool success){
+	counters old_counters = table_counters.load(), new_counters;	//memory order?
+	do{
+		new_counters = old_counters;
+		new_counters.inserters_and_flag = (new_counters.inserters_and_flag & counters::resize_flag_mask) | ((new_counters.inserters_and_flag - 1) & counters::inserters_mask);
+		if(success){
+			++(new_counters.elements);
+		}
+	}while(!table_counters.compare_exchange_weak(old_counters, new_counters));	//memory order?
+	return new_counters;
+}
+
+}
+
+#endif
\ No newline at end of file
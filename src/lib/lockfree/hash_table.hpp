@@ -2,17 +2,70 @@
 #define LOCKFREE_HASH_TABLE_H_INCLUDED
 
 #include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
 #include <atomic>
+#include <algorithm>
 #include <utility>
 #include <functional>
-#include "double_ref_counter.hpp"
+#include <type_traits>
+#include "reclamation.hpp"
+#include "../hashing/sizing.hpp"
+#include "../hashing/transparent.hpp"
+#include "../hashing/bulk_build.hpp"
 
 namespace lockfree{
 
 /*
  * A thread-safe lockfree hash table data structure.
+ *
+ * When a table fills up, a table of twice the size is appended to the
+ * chain of tables.  Writers always write to the newest table, and the
+ * contents of the oldest table are incrementally migrated forward by
+ * writers (a bounded batch of cells per operation).  Once the oldest
+ * table has been fully migrated, it is unlinked from the chain.  Hence
+ * reads usually only probe one table (two during a migration).
+ *
+ * Removed keys leave tombstones, which only a migration clears (another
+ * key can't safely take over a tombstone's cell, since a racing insert of
+ * that key may already have probed past it).  So once half of a table's
+ * capacity is tombstones, a table of the same size is appended instead,
+ * and migrating into it compacts the tombstones away.
+ *
+ * Tables and key-value pairs are kept alive by the Reclaimer policy (see
+ * reclamation.hpp).  With the default epoch policy, reads never write to
+ * shared memory.  Table sizes and probe positions follow the Sizing policy
+ * (see hashing/sizing.hpp).
+ *
+ * Lookups hash the key once for every table they probe.  They can also be
+ * given a precomputed hash (which must be hasher()(key)), and with a
+ * transparent hasher and comparer, keys of other types.  visit reads a
+ * value in place, while the Reclaimer keeps its pair alive, rather than
+ * copying it out.
+ *
+ * update, compute_if_absent, compare_and_set and fetch_add each replace a
+ * value with one computed from the current value, by CAS in the newest
+ * table (their functions may run more than once if they race).  First,
+ * they migrate the key's copies out of any older tables, so that those
+ * copies are frozen and nothing can change the value they start from.
+ *
+ * Iteration (const_iterator, for_each and parallel_for_each) is weakly
+ * consistent.  It walks every table in the chain, and only reports a pair
+ * when no newer table has a cell for its key, so each key is reported with
+ * its latest value at the time.  Keys set or removed meanwhile may or may
+ * not be seen, and a key whose cell is migrated meanwhile may be seen in
+ * both tables.
+ *
+ * A table can also be built from a range of (key, value) pairs.  It starts
+ * as a single table sized for all of them, which several threads fill at
+ * once, each in its own region of cells (see hashing/bulk_build.hpp).
+ * Later duplicates of a key win, as with set.
  */
-template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>>
+template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>, class Reclaimer = epoch_reclaimed<>, class Sizing = hashing::modulo_sizing>
 class hash_table{
 public:
 	
@@ -22,83 +75,476 @@ public:
 	using value_type = V;
 	using hasher = Hash;
 	using comparer = Compare;
+	class const_iterator;
 	
 	//Constructors/Destructor
 	hash_table(size_type s = 1) : definitive_table(s >= 1 ? s : 1) {}
-	hash_table(const hash_table& other) : definitive_table(other.definitive_table) {}	//Shallow copy.
+	template <class RandomIt> hash_table(RandomIt first, RandomIt last, size_type n_threads = 1);
+	hash_table(shared_copy_source<hash_table, Reclaimer> other) : definitive_table(other.definitive_table) {}	//Shallow copy, for reference counted tables only.
 	hash_table(hash_table&& other) : definitive_table(std::move(other.definitive_table)) {}
 	~hash_table() = default;
 	
 	//Assignment Operators
-	hash_table& operator=(const hash_table& other) {definitive_table = other.definitive_table; return *this;}	//Likewise.
+	hash_table& operator=(shared_copy_source<hash_table, Reclaimer> other) {definitive_table = other.definitive_table; return *this;}	//Likewise.
 	hash_table& operator=(hash_table&& other) {definitive_table = std::move(other.definitive_table); return *this;}
 	
 	//Member Functions
-	bool get(const key_type& key, value_type& ret_value) const;
-	void set(const key_type& key, const value_type& value) {generic_set(key, value, false);}
-	void remove(const key_type& key) {value_type unused; generic_set(key, unused, true);}
+	template <class F> bool visit(const key_type& key, F&& f) const;
+	bool get(const key_type& key, value_type& ret_value) const {return generic_get(key, hasher()(key), ret_value);}
+	template <class Q, class H = Hash, std::enable_if_t<hashing::is_transparent_v<H, Compare>, int> = 0>
+	bool get(const Q& key, value_type& ret_value) const {return generic_get(key, hasher()(key), ret_value);}
+	bool get_with_hash(std::size_t hash, const key_type& key, value_type& ret_value) const {return generic_get(key, hash, ret_value);}
+	template <class Q, class H = Hash, std::enable_if_t<hashing::is_transparent_v<H, Compare>, int> = 0>
+	bool get_with_hash(std::size_t hash, const Q& key, value_type& ret_value) const {return generic_get(key, hash, ret_value);}
+	void set(const key_type& key, const value_type& value) {typename Reclaimer::guard pin; generic_set(key, hasher()(key), value, false);}
+	void remove(const key_type& key) {typename Reclaimer::guard pin; value_type unused; generic_set(key, hasher()(key), unused, true);}
+	template <class F> bool update(const key_type& key, F&& f);
+	template <class F> bool compute_if_absent(const key_type& key, F&& f);
+	bool compare_and_set(const key_type& key, const value_type& expected, const value_type& desired);
+	value_type fetch_add(const key_type& key, const value_type& delta);
+	size_type get_batch(const key_type* keys, size_type count, value_type* ret_values, bool* found) const;
+	void set_batch(const key_type* keys, const value_type* values, size_type count);
+	const_iterator begin() const;
+	const_iterator end() const;
+	template <class F> void for_each(F&& f) const;
+	template <class F> void parallel_for_each(size_type n_threads, F&& f) const;
+	size_type chain_length() const;
 	
 private:
 	
 	//Private Types
 	class table;
+	template <class T> using pointer = typename Reclaimer::template pointer<T>;
 	
 	//Data Members
-	double_ref_counter<table> definitive_table;
+	pointer<table> definitive_table;
+	
+	//Static Data Members
+	static constexpr size_type migration_batch = 16;
+	static constexpr size_type batch_chunk = 32;	//Keys hashed (and prefetched) ahead of probing in a batch.
 	
 	//Private Member Functions
-	void generic_set(const key_type& key, const value_type& value, bool is_tombstone);
+	template <class Q> bool generic_get(const Q& key, std::size_t hash, value_type& ret_value) const;
+	template <class Q, class F> bool chain_visit(const table& oldest, const Q& key, std::size_t hash, F&& f) const;
+	void generic_set(const key_type& key, std::size_t hash, const value_type& value, bool is_tombstone);
+	void help_migrate();
+	template <class F> bool generic_modify(const key_type& key, std::size_t hash, F&& f);
+	static void migrate_cell(table& from, size_type i);
+	template <class F> void for_each_in(size_type part, size_type parts, F& f) const;
+	static bool superseded(const table& from, const key_type& key);
+	template <class RandomIt> void bulk_fill(RandomIt first, size_type count, size_type n_threads);
 	
 };
 
-template <class K, class V, class Hash, class Compare>
-bool hash_table<K, V, Hash, Compare>::get(const key_type& key, value_type& ret_value) const{
-	bool success = false, ret_tombstone = true;
-	typename double_ref_counter<table>::counted_ptr tbl = definitive_table.obtain();
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class RandomIt>
+hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::hash_table(RandomIt first, RandomIt last, size_type n_threads) : definitive_table(size_type(std::ceil(double(last - first) / table::capacity_percentage)) + 1){	//In double, since a float quotient (or product, for the capacity) can round below the count for large ranges.
+	bulk_fill(first, size_type(last - first), n_threads);
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class Q>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::generic_get(const Q& key, std::size_t hash, value_type& ret_value) const{
+	typename Reclaimer::guard pin;	//Reads leave migrating to the writers, so that with epochs they only load shared memory.
+	
+	typename pointer<table>::handle oldest = definitive_table.obtain();
+	return oldest.has_data() && chain_visit(*oldest, key, hash, [&](const value_type& value){ret_value = value;});	//Assumes copy assignment operator exists.
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::size_type hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::get_batch(const key_type* keys, size_type count, value_type* ret_values, bool* found) const{
+	typename Reclaimer::guard pin;	//One guard and one load of definitive_table for the whole batch.
+	
+	size_type found_count = 0;
+	std::size_t hashes[batch_chunk];
+	typename pointer<table>::handle oldest = definitive_table.obtain();	//If it's unlinked mid-batch, its chain still leads to every newer table.
+	for(size_type first = 0; first < count; first += batch_chunk){
+		size_type n = std::min(count - first, batch_chunk);
+		for(size_type i = 0; i < n; ++i){	//Hashing every key first gives the prefetches time to land before the probes.
+			hashes[i] = hasher()(keys[first + i]);
+			if(oldest.has_data()){
+				oldest->prefetch(hashes[i]);
+			}
+		}
+		for(size_type i = 0; i < n; ++i){
+			value_type& ret_value = ret_values[first + i];
+			found[first + i] = oldest.has_data() && chain_visit(*oldest, keys[first + i], hashes[i], [&](const value_type& value){ret_value = value;});
+			if(found[first + i]){
+				++found_count;
+			}
+		}
+	}
+	return found_count;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::set_batch(const key_type* keys, const value_type* values, size_type count){
+	typename Reclaimer::guard pin;
+	
+	std::size_t hashes[batch_chunk];
+	for(size_type first = 0; first < count; first += batch_chunk){
+		size_type n = std::min(count - first, batch_chunk);
+		typename pointer<table>::handle oldest = definitive_table.obtain();	//Only for prefetching, every set finds the newest table itself.
+		for(size_type i = 0; i < n; ++i){
+			hashes[i] = hasher()(keys[first + i]);
+			if(oldest.has_data()){
+				oldest->prefetch(hashes[i]);
+			}
+		}
+		for(size_type i = 0; i < n; ++i){
+			generic_set(keys[first + i], hashes[i], values[first + i], false);
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::visit(const key_type& key, F&& f) const{
+	typename Reclaimer::guard pin;
+	
+	typename pointer<table>::handle oldest = definitive_table.obtain();
+	return oldest.has_data() && chain_visit(*oldest, key, hasher()(key), std::forward<F>(f));
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class Q, class F>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::chain_visit(const table& oldest, const Q& key, std::size_t hash, F&& f) const{	//Assumes the caller holds a guard.
+	typename pointer<const typename table::kv_pair>::handle found = oldest.find(key, hash);
+	typename pointer<table>::handle tbl = oldest.next.obtain();
 	while(tbl.has_data()){
-		if(tbl->get(key, ret_value, ret_tombstone)){
-			success = !ret_tombstone;	//Always uses the last occurrance of the key as the definitive answer.
+		typename pointer<const typename table::kv_pair>::handle cell = tbl->find(key, hash);
+		if(cell.has_data()){
+			found = std::move(cell);	//Always uses the last occurrance of the key as the definitive answer.
 		}
 		tbl = std::move(tbl->next.obtain());
 	}
-	return success;
+	if(!found.has_data() || found->tombstone){
+		return false;
+	}
+	f(static_cast<const value_type&>(found->value));	//The handle keeps the pair alive, even if its table is unlinked meanwhile.
+	return true;
 }
 
-template <class K, class V, class Hash, class Compare>
-void hash_table<K, V, Hash, Compare>::generic_set(const key_type& key, const value_type& value, bool is_tombstone){
-	typename table::set_result result = table::set_result::failure;
-	typename double_ref_counter<table>::counted_ptr prev_tbl, tbl = definitive_table.obtain();
-	if(!tbl.has_data()){
-		if(!definitive_table.try_replace(tbl, 1)){	//Failure implies someone else made it non-null.
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::generic_set(const key_type& key, std::size_t hash, const value_type& value, bool is_tombstone){	//Assumes the caller holds a guard.
+	help_migrate();
+	
+	while(true){
+		bool older_live = false, ret_tombstone = true;
+		value_type unused;
+		typename pointer<table>::handle tbl = definitive_table.obtain();
+		if(!tbl.has_data()){
+			definitive_table.try_replace(tbl, 1);	//Failure implies someone else made it non-null.
 			tbl = definitive_table.obtain();
 		}
+		
+		typename pointer<table>::handle next_tbl = tbl->next.obtain();
+		bool migrating = next_tbl.has_data();
+		while(next_tbl.has_data()){	//Find the newest table.  Tombstones need to know if an older table still holds a live copy of the key.
+			if(is_tombstone && tbl->get(key, hash, unused, ret_tombstone)){
+				older_live = !ret_tombstone;
+			}
+			tbl = std::move(next_tbl);
+			next_tbl = tbl->next.obtain();
+		}
+		
+		typename table::set_result result = tbl->set(key, hash, value, is_tombstone, !is_tombstone || older_live, true);	//Tombstones are only inserted when they have to hide an older live copy.
+		if(result == table::set_result::failure){
+			tbl->next.try_replace(next_tbl, tbl->successor_size());	//Failure implies someone else made it non-null.
+		}else if(result != table::set_result::frozen){
+			if(is_tombstone && !migrating && tbl->compaction_due()){	//Compacting during a migration would only lengthen the chain, and the migration drops the oldest table's tombstones anyway.
+				tbl->next.try_replace(next_tbl, tbl->size);	//Migrating into a table of the same size drops the tombstones.
+			}
+			break;	//If the newest table was frozen, a newer table has been appended since we looked.  Otherwise we're done.
+		}
 	}
-	while(result != table::set_result::insert){	//Update appropriate kv_pairs in each table until an insert.
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::update(const key_type& key, F&& f){	//f is given a copy of the value to change, returns whether the key was present.
+	typename Reclaimer::guard pin;
+	return generic_modify(key, hasher()(key), [&](const value_type* current, value_type& desired){
+		if(current == nullptr){
+			return false;
+		}
+		desired = *current;
+		f(desired);
+		return true;
+	});
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::compute_if_absent(const key_type& key, F&& f){	//f makes the value to insert, returns whether it was inserted.
+	typename Reclaimer::guard pin;
+	return generic_modify(key, hasher()(key), [&](const value_type* current, value_type& desired){
+		if(current != nullptr){
+			return false;
+		}
+		desired = f();
+		return true;
+	});
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::compare_and_set(const key_type& key, const value_type& expected, const value_type& desired){
+	typename Reclaimer::guard pin;
+	return generic_modify(key, hasher()(key), [&](const value_type* current, value_type& ret_desired){
+		if(current == nullptr || !(*current == expected)){	//Assumes an equality operator exists.
+			return false;
+		}
+		ret_desired = desired;
+		return true;
+	});
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::value_type hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::fetch_add(const key_type& key, const value_type& delta){	//Absent keys count as zero, returns the value before the addition.
+	static_assert(std::is_arithmetic_v<value_type>, "fetch_add needs an arithmetic value_type.");
+	typename Reclaimer::guard pin;
+	value_type old_value = value_type();
+	generic_modify(key, hasher()(key), [&](const value_type* current, value_type& desired){
+		old_value = current != nullptr ? *current : value_type();	//Only the successful attempt's value is returned.
+		desired = old_value + delta;
+		return true;
+	});
+	return old_value;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::generic_modify(const key_type& key, std::size_t hash, F&& f){	//Assumes the caller holds a guard, returns whether f chose to write.
+	help_migrate();
+	
+	while(true){
+		typename pointer<table>::handle tbl = definitive_table.obtain();
 		if(!tbl.has_data()){
-			if(result == table::set_result::failure && !is_tombstone){
-				prev_tbl->next.try_replace(tbl, table::resize_factor * prev_tbl->size);	//Again, failure implies someone else made it non-null.
-				tbl = prev_tbl->next.obtain();
-			}else{
-				break;	//If updates occurred but no insert (or if nothing occurred and the pair was a tombstone), its fine to simply terminate.
-			}
+			definitive_table.try_replace(tbl, 1);	//Failure implies someone else made it non-null.
+			tbl = definitive_table.obtain();
 		}
 		
-		typename table::set_result current_result = tbl->set(key, value, is_tombstone);
-		if(current_result != table::set_result::failure){
-			result = current_result;
+		typename pointer<table>::handle older_tbl;	//Holds on to older's table, whose cells own older, since nothing else keeps it from being unlinked and reclaimed once we move past it.
+		typename pointer<const typename table::kv_pair>::handle older;	//The last copy of the key in an older table.
+		typename pointer<table>::handle next_tbl = tbl->next.obtain();
+		while(next_tbl.has_data()){
+			size_type i;
+			typename pointer<const typename table::kv_pair>::handle cell = tbl->find(key, hash, &i);
+			if(cell.has_data()){
+				if(!cell->frozen){	//A writer which hasn't seen the newer table could still change it, so freeze it first.
+					cell = typename pointer<const typename table::kv_pair>::handle();
+					next_tbl = typename pointer<table>::handle();	//Migrating takes a few handles of its own.
+					migrate_cell(*tbl, i);
+					cell = tbl->find(key, hash);
+					next_tbl = tbl->next.obtain();
+				}
+				older = std::move(cell);
+				older_tbl = std::move(tbl);
+			}
+			tbl = std::move(next_tbl);
+			next_tbl = tbl->next.obtain();
 		}
 		
-		prev_tbl = std::move(tbl);
-		tbl = prev_tbl->next.obtain();
+		typename table::set_result result = tbl->modify(key, hash, older.has_data() && !older->tombstone ? &older->value : nullptr, f);
+		if(result == table::set_result::failure){
+			tbl->next.try_replace(next_tbl, tbl->successor_size());	//Failure implies someone else made it non-null.
+		}else if(result != table::set_result::frozen){
+			return result == table::set_result::update || result == table::set_result::insert;
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::const_iterator hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::begin() const{
+	return const_iterator(*this);
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::const_iterator hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::end() const{
+	return const_iterator();
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::for_each(F&& f) const{	//f is given each key and value.
+	typename Reclaimer::guard pin;
+	for_each_in(0, 1, f);
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::parallel_for_each(size_type n_threads, F&& f) const{	//f is called from several threads at once, and mustn't throw.
+	if(n_threads < 1){
+		n_threads = 1;
+	}
+	std::vector<std::thread> workers;
+	workers.reserve(n_threads - 1);
+	for(size_type i = 1; i < n_threads; ++i){
+		workers.emplace_back([this, i, n_threads, &f](){
+			typename Reclaimer::guard pin;	//Each worker walks the chain for itself.
+			for_each_in(i, n_threads, f);
+		});
+	}
+	{
+		typename Reclaimer::guard pin;
+		for_each_in(0, n_threads, f);
+	}
+	for(auto i = workers.begin(); i != workers.end(); ++i){
+		i->join();
 	}
 }
 
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::size_type hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::chain_length() const{	//How many tables are in the chain, 1 unless a migration is under way.
+	typename Reclaimer::guard pin;
+	size_type length = 0;
+	for(typename pointer<table>::handle tbl = definitive_table.obtain(); tbl.has_data(); tbl = std::move(tbl->next.obtain())){
+		++length;
+	}
+	return length;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::help_migrate(){
+	typename pointer<table>::handle oldest = definitive_table.obtain();
+	if(!oldest.has_data()){
+		return;
+	}
+	typename pointer<table>::handle newer = oldest->next.obtain();
+	if(!newer.has_data()){
+		return;	//Only one table, nothing to migrate.
+	}
+	
+	size_type start = oldest->migration_claimed.load(), end;	//memory order?
+	do{
+		if(start >= oldest->size){
+			return;	//Every batch has been claimed, whoever claimed the last one will unlink the table.
+		}
+		end = std::min(oldest->size, start + migration_batch);
+	}while(!oldest->migration_claimed.compare_exchange_weak(start, end));	//memory order?
+	
+	for(size_type i = start; i < end; ++i){
+		migrate_cell(*oldest, i);
+	}
+	if(oldest->migration_completed.fetch_add(end - start) + (end - start) == oldest->size){	//memory order?
+		definitive_table.try_assign(oldest, oldest->next);	//Only the thread completing the migration unlinks the table, so this shouldn't fail.
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::migrate_cell(table& from, size_type i){
+	pointer<const typename table::kv_pair>& cell_ref = from.cells[i];
+	while(true){
+		typename pointer<const typename table::kv_pair>::handle cell = cell_ref.obtain();
+		if(!cell.has_data()){
+			if(cell_ref.try_replace(cell, table::frozen_vacant)){	//Nothing to move, but nobody may insert here anymore.
+				return;
+			}
+		}else if(cell->frozen || cell_ref.try_replace(cell, cell->key, cell->value, cell->tombstone, true)){	//Freezing the cell means no writer can update it after we copy it.  A cell someone else froze is copied too, since they may not have copied it yet, and the table mustn't be unlinked before they have.
+			if(cell->tombstone){
+				return;	//Tombstones don't need to be carried forward, newer tables hide older ones anyways.
+			}
+			
+			typename pointer<table>::handle tbl = from.next.obtain();
+			while(true){
+				typename table::set_result result = tbl->set(cell->key, hasher()(cell->key), cell->value, false, true, false);	//Never overwrite, newer tables always have newer values.
+				if(result != table::set_result::failure && result != table::set_result::frozen){
+					return;
+				}
+				
+				typename pointer<table>::handle next_tbl = tbl->next.obtain();
+				if(!next_tbl.has_data()){
+					tbl->next.try_replace(next_tbl, tbl->successor_size());	//Again, failure implies someone else made it non-null.
+					next_tbl = tbl->next.obtain();
+				}
+				tbl = std::move(next_tbl);
+			}
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::for_each_in(size_type part, size_type parts, F& f) const{	//Assumes the caller holds a guard, visits the given part of every table's cells.
+	typename pointer<table>::handle tbl = definitive_table.obtain();
+	while(tbl.has_data()){
+		size_type first = size_type(std::uint64_t(tbl->size) * part / parts), last = size_type(std::uint64_t(tbl->size) * (part + 1) / parts);
+		for(size_type i = first; i < last; ++i){
+			typename pointer<const typename table::kv_pair>::handle cell = tbl->cells[i].obtain();
+			if(cell.has_data() && !cell->vacant && !cell->tombstone && !superseded(*tbl, cell->key)){
+				f(static_cast<const key_type&>(cell->key), static_cast<const value_type&>(cell->value));
+			}
+		}
+		tbl = std::move(tbl->next.obtain());
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class RandomIt>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::bulk_fill(RandomIt first, size_type count, size_type n_threads){	//Assumes the table is a single empty table, and that nobody else can use it yet.
+	typename Reclaimer::guard pin;
+	typename pointer<table>::handle tbl = definitive_table.obtain();	//Kept alive by this thread for the workers.
+	std::size_t parts = std::max<std::size_t>(1, std::min(n_threads, tbl->size));
+	auto slices = hashing::partition(count, parts, [&](std::size_t i){return hasher()(first[i].first);}, [&](std::size_t hash){return hashing::region_of(Sizing::home(hash, tbl->size), tbl->size, parts);});
+	std::vector<std::vector<hashing::bulk_entry>> overflow(parts);
+	std::vector<size_type> filled(parts, 0);
+	
+	hashing::run_parallel(parts, [&](std::size_t region){	//Each thread only touches the cells of its own region, so none of its CASes can fail.
+		typename Reclaimer::guard worker_pin;
+		size_type end = size_type(hashing::region_begin(region + 1, tbl->size, parts));
+		for(std::size_t slice = 0; slice < parts; ++slice){
+			for(const hashing::bulk_entry& entry : slices[slice][region]){
+				const auto& pair = first[entry.index];
+				size_type i = Sizing::home(entry.hash, tbl->size);
+				for(; i < end; ++i){
+					typename pointer<const typename table::kv_pair>::handle cell = tbl->cells[i].obtain();
+					if(!cell.has_data()){
+						tbl->cells[i].try_replace(cell, pair.first, pair.second, false);
+						++filled[region];
+						break;
+					}else if(comparer()(cell->key, pair.first)){
+						tbl->cells[i].try_replace(cell, pair.first, pair.second, false);
+						break;
+					}
+				}
+				if(i == end){
+					overflow[region].push_back(entry);	//Its probe continues into the next region.
+				}
+			}
+		}
+	});
+	
+	size_type elements = 0;
+	for(size_type region_filled : filled){
+		elements += region_filled;
+	}
+	tbl->table_counters.store(typename table::counters{elements, 0});
+	for(auto region = overflow.begin(); region != overflow.end(); ++region){	//Once a key overflows, its later duplicates do too, so they're still inserted in order.
+		for(const hashing::bulk_entry& entry : *region){
+			generic_set(first[entry.index].first, entry.hash, first[entry.index].second, false);
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::superseded(const table& from, const key_type& key){	//Assumes the caller holds a guard.
+	std::size_t hash = hasher()(key);
+	typename pointer<table>::handle tbl = from.next.obtain();
+	while(tbl.has_data()){
+		if(tbl->find(key, hash).has_data()){
+			return true;	//A newer copy (or tombstone) of the key decides its value.
+		}
+		tbl = std::move(tbl->next.obtain());
+	}
+	return false;
+}
+
 /*
  * The actual data structure which contains key-value pairs.
  * Meant to be used as a component of the hash_table object.
  */
-template <class K, class V, class Hash, class Compare>
-class hash_table<K, V, Hash, Compare>::table{
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+class hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table{
 public:
 	
 	//Public Types
@@ -106,11 +552,14 @@ public:
 		failure,
 		update,
 		insert,
+		absent,		//The key wasn't found, and inserting wasn't allowed.
+		present,	//The key was found, and updating wasn't allowed.
+		frozen,		//The key's cell has been migrated, so the key belongs in a newer table.
 	};
 	
 	//Constructors/Destructor
 	table() = delete;
-	table(size_type s) : size(s), capacity(size_type(std::ceil(s * capacity_percentage))), table_counters(counters{0, 0}), next(), cells(new double_ref_counter<const kv_pair>[s]) {}
+	table(size_type s) : size(Sizing::round(s)), capacity(size_type(std::ceil(double(size) * capacity_percentage))), table_counters(counters{0, 0}), migration_claimed(0), migration_completed(0), tombstones(0), next(), cells(new pointer<const kv_pair>[size]) {}
 	table(const table&) = delete;
 	table(table&&) = delete;
 	~table() {delete [] cells;}
@@ -120,15 +569,20 @@ public:
 	table& operator=(table&&) = delete;
 	
 	//Member Functions
-	bool get(const key_type& key, value_type& ret_value, bool& ret_tombstone) const;
-	set_result set(const key_type& key, const value_type& value, bool is_tombstone);
+	template <class Q> bool get(const Q& key, std::size_t hash, value_type& ret_value, bool& ret_tombstone) const;
+	set_result set(const key_type& key, std::size_t hash, const value_type& value, bool is_tombstone, bool can_insert, bool can_update);
+	template <class F> set_result modify(const key_type& key, std::size_t hash, const value_type* older, F&& f);
+	void prefetch(std::size_t hash) const {__builtin_prefetch(cells + Sizing::home(hash, size));}
 	
 private:
 	
-	friend hash_table<K, V, Hash, Compare>;
+	friend hash_table<K, V, Hash, Compare, Reclaimer, Sizing>;
 	
 	//Private Types
 	struct kv_pair;
+	struct frozen_vacant_t{
+		explicit frozen_vacant_t() = default;
+	};
 	struct counters{
 		size_type elements;
 		size_type inserters_and_flag;	//Flag is wrapped up in here so this struct is not paddded to an irregular (non power-of-two) size.
@@ -143,62 +597,101 @@ private:
 	
 	//Atomic Data Members
 	std::atomic<counters> table_counters;
+	std::atomic<size_type> migration_claimed;	//Cells [0, migration_claimed) have been claimed by a migrating thread.
+	std::atomic<size_type> migration_completed;	//Number of cells which have been frozen (and copied forward if need be).
+	std::atomic<size_type> tombstones;	//Number of cells currently holding a tombstone.  Only a hint for compaction.
 	
 	//Table Data Members
-	double_ref_counter<table> next;
-	double_ref_counter<const kv_pair>* const cells;	//This is a const pointer, not a pointer to const data.
+	pointer<table> next;
+	pointer<const kv_pair>* const cells;	//This is a const pointer, not a pointer to const data.
 	
 	//Static Data Members
 	static constexpr float capacity_percentage = 0.7;
 	static constexpr size_type resize_factor = 2;
+	static constexpr frozen_vacant_t frozen_vacant{};
 	
 	//Private Member Functions
+	template <class Q> typename pointer<const kv_pair>::handle find(const Q& key, std::size_t hash, size_type* ret_index = nullptr) const;	//The key's cell, holding a live pair or a tombstone.
+	bool compaction_due() const {return tombstones.load() * 2 >= capacity;}	//memory order?
+	size_type successor_size() const {return compaction_due() ? size : resize_factor * size;}	//A table mostly full of tombstones is rebuilt rather than grown.
 	bool attempt_insert();
 	counters complete_insert(bool success);
 	
 };
 
-template <class K, class V, class Hash, class Compare>
-bool hash_table<K, V, Hash, Compare>::table::get(const key_type& key, value_type& ret_value, bool& ret_tombstone) const{
-	size_type index = hasher()(key) % size;
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class Q>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::template pointer<const typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::kv_pair>::handle hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::find(const Q& key, std::size_t hash, size_type* ret_index) const{
+	size_type index = Sizing::home(hash, size);
 	for(size_type i = 0; i < size; ++i){
-		typename double_ref_counter<const kv_pair>::counted_ptr cell = cells[(index + i) % size].obtain();
-		if(cell.has_data()){
+		typename pointer<const kv_pair>::handle cell = cells[Sizing::wrap(index + i, size)].obtain();
+		if(cell.has_data() && !cell->vacant){
 			if(comparer()(cell->key, key)){
-				ret_value = cell->value;	//Assumes copy assignment operator exists.
-				ret_tombstone = cell->tombstone;
-				return true;
+				if(ret_index != nullptr){
+					*ret_index = Sizing::wrap(index + i, size);
+				}
+				return cell;
 			}
 		}else{
-			return false;
+			break;	//Frozen vacant cells were empty when they were frozen, so the key can't be any further along.
 		}
 	}
-	return false;
+	return typename pointer<const kv_pair>::handle();
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class Q>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::get(const Q& key, std::size_t hash, value_type& ret_value, bool& ret_tombstone) const{
+	typename pointer<const kv_pair>::handle cell = find(key, hash);
+	if(!cell.has_data()){
+		return false;
+	}
+	ret_value = cell->value;	//Assumes copy assignment operator exists.
+	ret_tombstone = cell->tombstone;
+	return true;
 }
 
-template <class K, class V, class Hash, class Compare>
-typename hash_table<K, V, Hash, Compare>::table::set_result hash_table<K, V, Hash, Compare>::table::set(const key_type& key, const value_type& value, bool is_tombstone){
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::set_result hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::set(const key_type& key, std::size_t hash, const value_type& value, bool is_tombstone, bool can_insert, bool can_update){
 	bool attempted_insert = false;
 	set_result result = set_result::failure;
-	size_type index = hasher()(key);
+	size_type index = Sizing::home(hash, size);
 	for(size_type i = 0; i < size; ++i){
-		typename double_ref_counter<const kv_pair>::counted_ptr cell = cells[(index + i) % size].obtain();
+		typename pointer<const kv_pair>::handle cell = cells[Sizing::wrap(index + i, size)].obtain();
 		if(cell.has_data()){
-			if(comparer()(cell->key, key)){	//Keys are the same, attempt to update.
-				if(cells[(index + i) % size].try_replace(cell, key, value, is_tombstone)){
+			if(cell->vacant){	//Nothing can be inserted into a frozen vacant cell.
+				result = set_result::frozen;
+				break;
+			}else if(comparer()(cell->key, key)){	//Keys are the same, attempt to update.
+				if(!can_update){	//Even a frozen copy is newer than a migrating one, and whoever froze it carries it forward.
+					result = set_result::present;
+					break;
+				}else if(cell->frozen){
+					result = set_result::frozen;
+					break;
+				}else if(cells[Sizing::wrap(index + i, size)].try_replace(cell, key, value, is_tombstone)){
+					if(is_tombstone != cell->tombstone){
+						is_tombstone ? tombstones.fetch_add(1) : tombstones.fetch_sub(1);	//memory order?
+					}
 					result = set_result::update;
 					break;	//Successfully updated!
 				}else{
 					--i;	//Repeat the process.  Someone else modified the cell.
 				}
 			}
-		}else if(!is_tombstone){	//Empty cell found, attempt an insertion (unless its a tombstone).
+		}else if(!can_insert){
+			result = set_result::absent;
+			break;
+		}else{	//Empty cell found, attempt an insertion.
 			if(!attempted_insert){
 				if(!(attempted_insert = attempt_insert())){
 					break;
 				}
 			}
-			if(cells[(index + i) % size].try_replace(cell, key, value, false)){
+			if(cells[Sizing::wrap(index + i, size)].try_replace(cell, key, value, is_tombstone)){
+				if(is_tombstone){
+					tombstones.fetch_add(1);	//memory order?
+				}
 				result = set_result::insert;
 				break;	//Successfully inserted!
 			}else{
@@ -212,8 +705,63 @@ typename hash_table<K, V, Hash, Compare>::table::set_result hash_table<K, V, Has
 	return result;
 }
 
-template <class K, class V, class Hash, class Compare>
-bool hash_table<K, V, Hash, Compare>::table::attempt_insert(){
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+template <class F>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::set_result hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::modify(const key_type& key, std::size_t hash, const value_type* older, F&& f){
+	bool attempted_insert = false;
+	set_result result = set_result::failure;
+	size_type index = Sizing::home(hash, size);
+	for(size_type i = 0; i < size; ++i){	//Same probe as set, but the value written is chosen by f(current value or nullptr, desired value).
+		typename pointer<const kv_pair>::handle cell = cells[Sizing::wrap(index + i, size)].obtain();
+		if(cell.has_data()){
+			if(cell->vacant){
+				result = set_result::frozen;
+				break;
+			}else if(comparer()(cell->key, key)){
+				value_type desired;
+				if(cell->frozen){
+					result = set_result::frozen;
+					break;
+				}else if(!f(cell->tombstone ? nullptr : &cell->value, desired)){	//A tombstone hides any older copies.
+					result = set_result::present;
+					break;
+				}else if(cells[Sizing::wrap(index + i, size)].try_replace(cell, key, desired, false)){
+					if(cell->tombstone){
+						tombstones.fetch_sub(1);	//memory order?
+					}
+					result = set_result::update;
+					break;
+				}else{
+					--i;	//Repeat the process.  Someone else modified the cell.
+				}
+			}
+		}else{	//The key isn't in this table, so its value is whatever the older tables hold.
+			value_type desired;
+			if(!f(older, desired)){
+				result = set_result::absent;
+				break;
+			}
+			if(!attempted_insert){
+				if(!(attempted_insert = attempt_insert())){
+					break;
+				}
+			}
+			if(cells[Sizing::wrap(index + i, size)].try_replace(cell, key, desired, false)){
+				result = set_result::insert;
+				break;
+			}else{
+				--i;	//Repeat the process.  Someone else modified the cell.
+			}
+		}
+	}
+	if(attempted_insert){
+		complete_insert(result == set_result::insert);
+	}
+	return result;
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+bool hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::attempt_insert(){
 	counters old_counters = table_counters.load(), new_counters;	//memory order?
 	do{
 		new_counters = old_counters;
@@ -230,8 +778,8 @@ bool hash_table<K, V, Hash, Compare>::table::attempt_insert(){
 	return true;
 }
 
-template <class K, class V, class Hash, class Compare>
-typename hash_table<K, V, Hash, Compare>::table::counters hash_table<K, V, Hash, Compare>::table::complete_insert(bool success){
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::counters hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::complete_insert(bool success){
 	counters old_counters = table_counters.load(), new_counters;	//memory order?
 	do{
 		new_counters = old_counters;
@@ -246,13 +794,18 @@ typename hash_table<K, V, Hash, Compare>::table::counters hash_table<K, V, Hash,
 /*
  * A key-value data structure used to store information about
  * keys and values in the table objects.
+ *
+ * Frozen kv_pairs are the ones which have been migrated to a newer
+ * table (they remain readable until the table is unlinked).  A frozen
+ * vacant kv_pair stands in for an empty cell which has been migrated.
  */
-template <class K, class V, class Hash, class Compare>
-struct hash_table<K, V, Hash, Compare>::table::kv_pair{
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+struct hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::table::kv_pair{
 	
 	//Constructors/Destructor
 	kv_pair() = delete;
-	kv_pair(const key_type& k, const value_type& v, bool t) : key(k), value(v), tombstone(t) {}
+	kv_pair(const key_type& k, const value_type& v, bool t, bool f = false) : key(k), value(v), tombstone(t), frozen(f), vacant(false) {}
+	kv_pair(frozen_vacant_t) : key(), value(), tombstone(true), frozen(true), vacant(true) {}
 	kv_pair(const kv_pair&) = delete;
 	kv_pair(kv_pair&&) = delete;
 	~kv_pair() = default;
@@ -265,9 +818,81 @@ struct hash_table<K, V, Hash, Compare>::table::kv_pair{
 	key_type key;
 	value_type value;
 	bool tombstone;
+	bool frozen;
+	bool vacant;
 	
 };
 
+/*
+ * An input iterator over a hash_table's pairs, weakly consistent as
+ * described above.  It holds a guard while it exists, so it shouldn't be
+ * kept for long (with epochs, it holds back all reclamation).
+ */
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+class hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::const_iterator{
+public:
+	
+	//Public Types
+	using iterator_category = std::input_iterator_tag;
+	using reference = std::pair<const K&, const V&>;
+	using value_type = reference;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	
+	//Constructors/Destructor
+	const_iterator() : pin(), tbl(), index(0), current() {}
+	const_iterator(const const_iterator&) = delete;	//Each iterator holds its own guard and handles.
+	const_iterator(const_iterator&&) = default;
+	~const_iterator() = default;
+	
+	//Assignment Operators
+	const_iterator& operator=(const const_iterator&) = delete;
+	const_iterator& operator=(const_iterator&&) = default;
+	
+	//Member Functions
+	reference operator*() const {return reference(current->key, current->value);}
+	const_iterator& operator++() {++index; settle(); return *this;}
+	bool operator==(const const_iterator& other) const {return (current.has_data() ? &*current : nullptr) == (other.current.has_data() ? &*other.current : nullptr);}
+	bool operator!=(const const_iterator& other) const {return !(*this == other);}
+	
+private:
+	
+	friend hash_table<K, V, Hash, Compare, Reclaimer, Sizing>;
+	
+	//Constructors/Destructor
+	explicit const_iterator(const hash_table<K, V, Hash, Compare, Reclaimer, Sizing>& owner);
+	
+	//Data Members
+	std::unique_ptr<typename Reclaimer::guard> pin;	//Declared first, so that it's released last.
+	typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::template pointer<table>::handle tbl;
+	size_type index;
+	typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::template pointer<const typename table::kv_pair>::handle current;
+	
+	//Private Member Functions
+	void settle();
+	
+};
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::const_iterator::const_iterator(const hash_table<K, V, Hash, Compare, Reclaimer, Sizing>& owner) : pin(std::make_unique<typename Reclaimer::guard>()), tbl(owner.definitive_table.obtain()), index(0), current(){
+	settle();
+}
+
+template <class K, class V, class Hash, class Compare, class Reclaimer, class Sizing>
+void hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::const_iterator::settle(){	//Moves to the first pair at or after index which should be reported.
+	while(tbl.has_data()){
+		for(; index < tbl->size; ++index){
+			current = tbl->cells[index].obtain();
+			if(current.has_data() && !current->vacant && !current->tombstone && !superseded(*tbl, current->key)){
+				return;
+			}
+		}
+		tbl = std::move(tbl->next.obtain());
+		index = 0;
+	}
+	current = typename hash_table<K, V, Hash, Compare, Reclaimer, Sizing>::template pointer<const typename table::kv_pair>::handle();
+}
+
 }
 
 #endif
\ No newline at end of file
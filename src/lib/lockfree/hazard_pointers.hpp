@@ -0,0 +1,524 @@
+#ifndef LOCKFREE_HAZARD_POINTERS_H_INCLUDED
+#define LOCKFREE_HAZARD_POINTERS_H_INCLUDED
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "double_ref_counter.hpp"
+
+namespace lockfree{
+
+/*
+ * A hazard pointer memory reclamation domain.
+ *
+ * Threads publish the nodes they're about to access in one of their
+ * hazard slots, and nodes which have been unlinked are retired rather
+ * than deleted.  Once a thread has retired enough nodes it scans every
+ * thread's slots, and deletes whichever of its nodes aren't published.
+ *
+ * Unlike an epoch, a descheduled reader can only hold back the nodes it
+ * has published, so each thread's garbage stays bounded by the total
+ * number of slots.  Publishing costs a store and a fence to the calling
+ * thread's own record.  Slots come in blocks, and a thread which needs
+ * more than a block's worth (say, by holding handles across several
+ * operations) is given another block rather than failing.  Domains must
+ * outlive any use of them, but threads may outlive domains.
+ */
+class hazard_domain{
+public:
+	
+	//Public Types
+	class slot;
+	
+	//Constructors/Destructor
+	hazard_domain();
+	hazard_domain(const hazard_domain&) = delete;
+	hazard_domain(hazard_domain&&) = delete;
+	~hazard_domain();
+	
+	//Assignment Operators
+	hazard_domain& operator=(const hazard_domain&) = delete;
+	hazard_domain& operator=(hazard_domain&&) = delete;
+	
+	//Member Functions
+	template <class T, class Allocator = new_allocator> void retire(T* ptr);
+	
+	//Static Data Members
+	static constexpr unsigned int slots_per_block = 8;
+	
+private:
+	
+	//Private Types
+	struct retired_node{
+		void* ptr;
+		void (*deleter)(void*);
+	};
+	struct slot_block{
+		slot_block();
+		slot_block(const slot_block&) = delete;
+		~slot_block() {delete next.load();}
+		slot_block& operator=(const slot_block&) = delete;
+		
+		std::atomic<void*> hazards[slots_per_block];
+		unsigned int used_slots;	//Bitmask, only touched by the owning thread.
+		std::atomic<slot_block*> next;	//Only ever appended to by the owning thread, and freed with the domain.
+	};
+	struct alignas(64) thread_record{	//Aligned so that records of different threads don't share a cache line.
+		slot_block slots;
+		std::atomic<bool> in_use;
+		std::vector<retired_node> retired;
+		std::size_t scan_at;	//Grows with whatever couldn't be reclaimed last time, so scanning stays amortized constant.
+		thread_record* next;
+	};
+	class thread_cache;
+	
+	//Data Members
+	const unsigned long id;	//Unlike addresses, ids are never reused, so a thread can tell if a domain it used has been destroyed.
+	std::atomic<thread_record*> records;
+	
+	//Static Data Members
+	static constexpr std::size_t scan_threshold = 64;
+	
+	//Private Member Functions
+	thread_record& local_record();
+	thread_record& acquire_record();
+	void scan(thread_record& rec);
+	
+	//Private Static Member Functions
+	static unsigned long next_id();
+	static std::mutex& live_domains_mutex();
+	static std::vector<unsigned long>& live_domains();
+	
+};
+
+/*
+ * One of the calling thread's hazard slots, held for the lifetime of
+ * this object.  Only the thread which acquired a slot may use it.
+ */
+class hazard_domain::slot{
+public:
+	
+	//Constructors/Destructor
+	slot() : block(nullptr), index(0) {}
+	explicit slot(hazard_domain& domain);
+	slot(const slot&) = delete;
+	slot(slot&& other) : block(other.block), index(other.index) {other.block = nullptr;}
+	~slot() {release();}
+	
+	//Assignment Operators
+	slot& operator=(const slot&) = delete;
+	slot& operator=(slot&& other);
+	
+	//Member Functions
+	template <class T> T* protect(const std::atomic<T*>& source);
+	void release();
+	
+private:
+	
+	//Data Members
+	slot_block* block;
+	unsigned int index;
+	
+};
+
+/*
+ * The records a thread has acquired in each domain it has used.
+ * When the thread exits, its records are given up (along with any
+ * garbage not yet reclaimed) to be adopted by other threads.
+ */
+class hazard_domain::thread_cache{
+public:
+	
+	//Public Types
+	struct entry{
+		unsigned long domain_id;
+		hazard_domain* domain;
+		thread_record* rec;
+	};
+	
+	//Constructors/Destructor
+	thread_cache() : last{0, nullptr, nullptr}, entries() {}
+	thread_cache(const thread_cache&) = delete;
+	thread_cache(thread_cache&&) = delete;
+	~thread_cache();
+	
+	//Assignment Operators
+	thread_cache& operator=(const thread_cache&) = delete;
+	thread_cache& operator=(thread_cache&&) = delete;
+	
+	//Data Members
+	entry last;	//Most threads only use one domain, so remember the last one used.
+	std::vector<entry> entries;
+	
+};
+
+inline hazard_domain::thread_cache::~thread_cache(){
+	std::unique_lock lk(live_domains_mutex());	//Keeps the domains from being destroyed while their records are given up.
+	std::vector<unsigned long>& live = live_domains();
+	for(auto i = entries.begin(); i != entries.end(); ++i){
+		if(std::find(live.begin(), live.end(), i->domain_id) != live.end()){
+			i->domain->scan(*(i->rec));
+			i->rec->in_use.store(false);
+		}
+	}
+}
+
+inline hazard_domain::hazard_domain() : id(next_id()), records(nullptr){
+	std::unique_lock lk(live_domains_mutex());
+	live_domains().push_back(id);
+}
+
+inline hazard_domain::~hazard_domain(){
+	{
+		std::unique_lock lk(live_domains_mutex());
+		std::vector<unsigned long>& live = live_domains();
+		live.erase(std::find(live.begin(), live.end(), id));
+	}
+	
+	for(bool drained = false; !drained;){	//Nobody is using the domain anymore, so everything can be deleted.
+		drained = true;
+		for(thread_record* rec = records.load(); rec != nullptr; rec = rec->next){	//Deleters may retire more nodes (to this thread's record, which may come earlier), so every record stays until none has any left.
+			std::vector<retired_node> reclaimable;
+			reclaimable.swap(rec->retired);
+			for(auto i = reclaimable.begin(); i != reclaimable.end(); ++i){
+				i->deleter(i->ptr);
+				drained = false;
+			}
+		}
+	}
+	
+	thread_record* rec = records.load();
+	while(rec != nullptr){
+		thread_record* next = rec->next;
+		delete rec;
+		rec = next;
+	}
+}
+
+template <class T, class Allocator>
+void hazard_domain::retire(T* ptr){
+	thread_record& rec = local_record();
+	rec.retired.push_back(retired_node{const_cast<std::remove_const_t<T>*>(ptr), [](void* p){Allocator::destroy(static_cast<T*>(p));}});
+	if(rec.retired.size() >= rec.scan_at){
+		scan(rec);
+		rec.scan_at = scan_threshold + 2 * rec.retired.size();
+	}
+}
+
+inline hazard_domain::thread_record& hazard_domain::local_record(){
+	static thread_local thread_cache cache;
+	if(cache.last.domain_id == id){
+		return *(cache.last.rec);
+	}
+	
+	for(auto i = cache.entries.begin(); i != cache.entries.end(); ++i){
+		if(i->domain_id == id){
+			cache.last = *i;
+			return *(i->rec);
+		}
+	}
+	cache.entries.push_back(thread_cache::entry{id, this, &acquire_record()});
+	cache.last = cache.entries.back();
+	return *(cache.last.rec);
+}
+
+inline hazard_domain::thread_record& hazard_domain::acquire_record(){
+	for(thread_record* r = records.load(); r != nullptr; r = r->next){	//Records are only freed with the domain, so threads which have exited leave theirs to be adopted.
+		bool expected = false;
+		if(!r->in_use.load() && r->in_use.compare_exchange_strong(expected, true)){
+			return *r;
+		}
+	}
+	
+	thread_record* rec = new thread_record{{}, {true}, {}, scan_threshold, records.load()};
+	while(!records.compare_exchange_weak(rec->next, rec)){}	//memory order?
+	return *rec;
+}
+
+inline void hazard_domain::scan(thread_record& rec){
+	std::vector<void*> published;
+	for(thread_record* r = records.load(); r != nullptr; r = r->next){
+		for(slot_block* b = &(r->slots); b != nullptr; b = b->next.load()){
+			for(unsigned int i = 0; i < slots_per_block; ++i){
+				void* p = b->hazards[i].load();
+				if(p != nullptr){
+					published.push_back(p);
+				}
+			}
+		}
+	}
+	std::sort(published.begin(), published.end());
+	
+	auto still_hazardous = std::partition(rec.retired.begin(), rec.retired.end(), [&published](const retired_node& n){return std::binary_search(published.begin(), published.end(), n.ptr);});
+	std::vector<retired_node> reclaimable(still_hazardous, rec.retired.end());	//Deleters may retire more nodes, so don't delete straight out of the vector.
+	rec.retired.erase(still_hazardous, rec.retired.end());
+	for(auto i = reclaimable.begin(); i != reclaimable.end(); ++i){
+		i->deleter(i->ptr);
+	}
+}
+
+inline unsigned long hazard_domain::next_id(){
+	static std::atomic<unsigned long> ids(1);	//Zero is never handed out, so it can mark an empty thread_cache entry.
+	return ids.fetch_add(1);
+}
+
+inline std::mutex& hazard_domain::live_domains_mutex(){
+	static std::mutex* mu = new std::mutex();	//Never destroyed, since threads may exit after static destruction has begun.
+	return *mu;
+}
+
+inline std::vector<unsigned long>& hazard_domain::live_domains(){
+	static std::vector<unsigned long>* live = new std::vector<unsigned long>();	//Likewise.
+	return *live;
+}
+
+inline hazard_domain::slot_block::slot_block() : used_slots(0), next(nullptr){
+	for(unsigned int i = 0; i < slots_per_block; ++i){
+		hazards[i].store(nullptr);
+	}
+}
+
+inline hazard_domain::slot::slot(hazard_domain& domain) : block(&(domain.local_record().slots)), index(0){
+	while(block->used_slots == (1u << slots_per_block) - 1){	//Blocks are never given back, so a thread only allocates as many as it has ever needed at once.
+		slot_block* next = block->next.load();
+		if(next == nullptr){
+			next = new slot_block();
+			block->next.store(next);	//Published only once initialized, so a scan never reads garbage.
+		}
+		block = next;
+	}
+	while(block->used_slots & (1u << index)){
+		++index;
+	}
+	block->used_slots |= 1u << index;
+}
+
+inline hazard_domain::slot& hazard_domain::slot::operator=(slot&& other){
+	release();
+	block = other.block;
+	index = other.index;
+	other.block = nullptr;
+	return *this;
+}
+
+template <class T>
+T* hazard_domain::slot::protect(const std::atomic<T*>& source){
+	T* ptr = source.load();	//memory order?
+	while(true){
+		block->hazards[index].store(const_cast<std::remove_const_t<T>*>(ptr));	//Sequentially consistent, so the scan either sees this or we see the source change.
+		T* current = source.load();
+		if(current == ptr){
+			return ptr;
+		}
+		ptr = current;
+	}
+}
+
+inline void hazard_domain::slot::release(){
+	if(block != nullptr){
+		block->hazards[index].store(nullptr, std::memory_order_release);
+		block->used_slots &= ~(1u << index);
+		block = nullptr;
+	}
+}
+
+/*
+ * The domain used by hazard_ptr unless told otherwise.  Other domains
+ * can be supplied by any type with a static instance() function
+ * returning a hazard_domain.
+ */
+struct default_hazard_domain{
+	static hazard_domain& instance() {static hazard_domain* domain = new hazard_domain(); return *domain;}	//Never destroyed, since threads may exit after static destruction has begun.
+};
+
+/*
+ * An atomic owning pointer whose old values are retired to a hazard domain.
+ *
+ * Offers the same operations as a double_ref_counter.  The guarded_ptrs
+ * it hands out each hold one of the calling thread's hazard slots.
+ *
+ * Data is usually owned by a single hazard_ptr, but try_assign shares it
+ * (another hazard_ptr inside an unlinked node may still lead readers to
+ * it), so each node keeps a count of its owners.  Nodes are made and
+ * destroyed through the Allocator policy.
+ */
+template <class T, class Domain = default_hazard_domain, class Allocator = new_allocator>
+class hazard_ptr{
+public:
+	
+	//Public Types
+	using value_type = T;
+	class guarded_ptr;
+	using handle = guarded_ptr;
+	
+	//Default and Internal Default Constructors
+	hazard_ptr() : ptr(nullptr) {}
+	hazard_ptr(default_construct_t) : ptr(Allocator::template create<node>()) {}
+	
+	//Forwarding Constructors
+	//Same restrictions as the double_ref_counter's forwarding constructors.
+	template <class Arg, class = std::enable_if_t<!std::is_same_v<hazard_ptr, std::remove_cv_t<std::remove_reference_t<Arg>>>>>
+	hazard_ptr(Arg&& arg) : ptr(Allocator::template create<node>(std::forward<Arg>(arg))) {}
+	template <class... Args, class = std::enable_if_t<sizeof...(Args) >= 2>>
+	hazard_ptr(Args&&... args) : ptr(Allocator::template create<node>(std::forward<Args>(args)...)) {}
+	
+	//Copy/Move Constructors and Destructor
+	hazard_ptr(const hazard_ptr&) = delete;
+	hazard_ptr(hazard_ptr&& other) : ptr(other.ptr.exchange(nullptr)) {}
+	~hazard_ptr();
+	
+	//Assignment Operators
+	hazard_ptr& operator=(const hazard_ptr&) = delete;
+	hazard_ptr& operator=(hazard_ptr&& other);
+	
+	//Member Functions
+	guarded_ptr obtain() const;
+	template <class... Args> void replace(Args&&... args);
+	template <class... Args> bool try_replace(const guarded_ptr& expected, Args&&... args);
+	bool try_assign(const guarded_ptr& expected, hazard_ptr& other);
+	void erase();
+	
+private:
+	
+	//Private Types
+	struct node{
+		template <class... Args> node(Args&&... args) : value(std::forward<Args>(args)...), owners(1) {}
+		
+		value_type value;
+		std::atomic<unsigned int> owners;
+	};
+	
+	//Data Members
+	std::atomic<node*> ptr;
+	
+	//Private Static Member Functions
+	static void release(node* old) {if(old != nullptr && old->owners.fetch_sub(1) == 1){Domain::instance().template retire<node, Allocator>(old);}}	//memory order?
+	
+};
+
+template <class T, class Domain, class Allocator>
+hazard_ptr<T, Domain, Allocator>::~hazard_ptr(){
+	release(ptr.load());	//Even when this was the only owner, a reader may have published the node without a hazard on whatever held this pointer, so it's retired rather than destroyed.
+}
+
+template <class T, class Domain, class Allocator>
+hazard_ptr<T, Domain, Allocator>& hazard_ptr<T, Domain, Allocator>::operator=(hazard_ptr&& other){
+	release(ptr.exchange(other.ptr.exchange(nullptr)));	//memory order?
+	return *this;
+}
+
+template <class T, class Domain, class Allocator>
+typename hazard_ptr<T, Domain, Allocator>::guarded_ptr hazard_ptr<T, Domain, Allocator>::obtain() const{
+	hazard_domain::slot s(Domain::instance());
+	node* n = s.protect(ptr);
+	if(n == nullptr){
+		return guarded_ptr();	//Don't tie up a slot for nothing.
+	}
+	return guarded_ptr(n, std::move(s));
+}
+
+template <class T, class Domain, class Allocator>
+template <class... Args>
+void hazard_ptr<T, Domain, Allocator>::replace(Args&&... args){
+	release(ptr.exchange(Allocator::template create<node>(std::forward<Args>(args)...)));	//memory order?
+}
+
+template <class T, class Domain, class Allocator>
+template <class... Args>
+bool hazard_ptr<T, Domain, Allocator>::try_replace(const guarded_ptr& expected, Args&&... args){
+	node* old_ptr = ptr.load();	//memory order?
+	if(old_ptr != expected.guarded){
+		return false;
+	}
+	
+	node* new_ptr = Allocator::template create<node>(std::forward<Args>(args)...);
+	if(!ptr.compare_exchange_strong(old_ptr, new_ptr)){	//memory order?
+		Allocator::destroy(new_ptr);
+		return false;
+	}
+	release(old_ptr);
+	return true;
+}
+
+/*
+ * Shares other's data if this pointer still holds expected.
+ * Other must currently be protected by the caller (it's meant to belong
+ * to a node which is about to be unlinked).
+ */
+template <class T, class Domain, class Allocator>
+bool hazard_ptr<T, Domain, Allocator>::try_assign(const guarded_ptr& expected, hazard_ptr& other){
+	node* shared_ptr = other.ptr.load();	//memory order?
+	if(shared_ptr != nullptr){
+		shared_ptr->owners.fetch_add(1);	//Can't hit zero in the meantime, since other still owns it.
+	}
+	
+	node* old_ptr = expected.guarded;
+	if(!ptr.compare_exchange_strong(old_ptr, shared_ptr)){	//memory order?
+		if(shared_ptr != nullptr){
+			shared_ptr->owners.fetch_sub(1);
+		}
+		return false;
+	}
+	release(old_ptr);
+	return true;
+}
+
+template <class T, class Domain, class Allocator>
+void hazard_ptr<T, Domain, Allocator>::erase(){
+	release(ptr.exchange(nullptr));	//memory order?
+}
+
+/*
+ * The RAII class protecting access to a hazard_ptr's data.
+ * This object is not thread-safe, and should not be shared between threads.
+ */
+template <class T, class Domain, class Allocator>
+class hazard_ptr<T, Domain, Allocator>::guarded_ptr{
+public:
+	
+	//Constructors/Destructor
+	guarded_ptr() : guarded(nullptr), hazard() {}
+	guarded_ptr(const guarded_ptr&) = delete;
+	guarded_ptr(guarded_ptr&& other) : guarded(other.guarded), hazard(std::move(other.hazard)) {other.guarded = nullptr;}
+	~guarded_ptr() = default;	//The slot releases itself.
+	
+	//Assignment Operators
+	guarded_ptr& operator=(const guarded_ptr&) = delete;
+	guarded_ptr& operator=(guarded_ptr&& other);
+	
+	//Properties Functions
+	bool has_data() const {return guarded != nullptr;}
+	
+	//Accessors
+	//Can throw nullptr exceptions.  Constness follows value_type, as with double_ref_counter::counted_ptr.
+	value_type& operator*() const {return guarded->value;}
+	value_type* operator->() const {return &(guarded->value);}
+	
+private:
+	
+	friend hazard_ptr<T, Domain, Allocator>;
+	
+	//Private Constructors
+	guarded_ptr(node* n, hazard_domain::slot&& s) : guarded(n), hazard(std::move(s)) {}
+	
+	//Data Members
+	node* guarded;
+	hazard_domain::slot hazard;
+	
+};
+
+template <class T, class Domain, class Allocator>
+typename hazard_ptr<T, Domain, Allocator>::guarded_ptr& hazard_ptr<T, Domain, Allocator>::guarded_ptr::operator=(guarded_ptr&& other){
+	guarded = other.guarded;
+	hazard = std::move(other.hazard);	//Other's slot is already published, so releasing ours first leaves no gap.
+	other.guarded = nullptr;
+	return *this;
+}
+
+}
+
+#endif
\ No newline at end of file
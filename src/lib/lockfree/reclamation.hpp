@@ -0,0 +1,79 @@
+#ifndef LOCKFREE_RECLAMATION_H_INCLUDED
+#define LOCKFREE_RECLAMATION_H_INCLUDED
+
+#include <type_traits>
+#include "epoch.hpp"
+#include "allocation.hpp"
+#include "hazard_pointers.hpp"
+#include "double_ref_counter.hpp"
+
+namespace lockfree{
+
+/*
+ * Reclamation policies for the lockfree hash tables.
+ *
+ * A policy supplies the atomic owning pointer type which tables keep
+ * their nodes in (anything with double_ref_counter's interface and a
+ * handle type), and a guard which is held for the duration of every
+ * table operation.  Each policy also takes an allocation policy (see
+ * allocation.hpp) for the tables' nodes, so pooled_allocator can keep
+ * steady-state updates away from the global allocator.
+ */
+
+/*
+ * Keeps nodes alive with double_ref_counters.  Every obtain is a
+ * double-width CAS, but no guard is needed.
+ */
+template <class Allocator = new_allocator>
+struct ref_counted{
+	
+	//Public Types
+	template <class T> using pointer = double_ref_counter<T, Allocator>;
+	struct guard{
+		guard() {}	//User-provided so that unused guards don't trigger warnings.
+	};
+	
+};
+
+/*
+ * Keeps nodes alive by pinning an epoch domain, so obtains are plain loads.
+ */
+template <class Domain = default_epoch_domain, class Allocator = new_allocator>
+struct epoch_reclaimed{
+	
+	//Public Types
+	template <class T> using pointer = epoch_ptr<T, Domain, Allocator>;
+	using guard = epoch_guard<Domain>;
+	
+};
+
+/*
+ * Keeps nodes alive by publishing them in a hazard domain.  Obtains cost
+ * a fence, but a stalled thread can only hold back the nodes it has
+ * published.
+ */
+template <class Domain = default_hazard_domain, class Allocator = new_allocator>
+struct hazard_reclaimed{
+	
+	//Public Types
+	template <class T> using pointer = hazard_ptr<T, Domain, Allocator>;
+	struct guard{
+		guard() {}
+	};
+	
+};
+
+/*
+ * The parameter of a table's copy operations.  It's the table itself when
+ * the Reclaimer's pointers can be shared (so that copies share one chain of
+ * tables), and otherwise a type nothing converts to, so the table is only
+ * movable.
+ */
+struct no_shared_copies;
+
+template <class Table, class Reclaimer>
+using shared_copy_source = std::conditional_t<std::is_copy_constructible_v<typename Reclaimer::template pointer<int>>, const Table&, const no_shared_copies&>;
+
+}
+
+#endif
\ No newline at end of file
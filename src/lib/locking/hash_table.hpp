@@ -4,15 +4,64 @@
 #include <cmath>
 #include <mutex>
 #include <memory>
+#include <utility>
+#include <algorithm>
 #include <functional>
 #include <shared_mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include "../hashing/sizing.hpp"
+#include "../hashing/control_group.hpp"
+#include "../hashing/transparent.hpp"
+#include "../hashing/bulk_build.hpp"
+#include "../hashing/snapshot.hpp"
 
 namespace locking{
 
 /*
  * A thread-safe locking hash table.
+ *
+ * Alongside the cells is an array of control bytes (see
+ * hashing/control_group.hpp), which probes scan 16 at a time, so a probe
+ * only follows a cell's pointer when its hash tag matches.  A miss
+ * usually costs a load of one or two groups of control bytes.
+ *
+ * Inserts reuse the first tombstone on their probe path, and once half of
+ * the capacity is tombstones the table is rehashed in place to clear them.
+ * Table sizes and probe positions follow the Sizing policy (see
+ * hashing/sizing.hpp).
+ *
+ * Lookups can be given a precomputed hash (which must be hasher()(key)),
+ * and with a transparent hasher and comparer, keys of other types.
+ * visit reads a value in place (under the shared lock, so the visitor
+ * mustn't use the table), and emplace and insert_or_assign construct or
+ * move values straight into their pairs.  Both return whether the key
+ * was inserted.
+ *
+ * update, compute_if_absent, compare_and_set and fetch_add each change a
+ * value atomically (under the exclusive lock), and update and fetch_add
+ * change it in place.
+ *
+ * for_each and parallel_for_each visit every pair under the shared lock,
+ * the latter splitting the cells between several threads.
+ *
+ * A table can also be built from a range of (key, value) pairs, sized for
+ * all of them up front and filled by several threads at once (see
+ * hashing/bulk_build.hpp).  Later duplicates of a key win, as with set.
+ *
+ * With trivially copyable keys and values, save writes the table out as a
+ * flat image (see hashing/snapshot.hpp), and open_mapped maps one back in.
+ * A mapped table answers reads straight from the file's pages, and only
+ * copies them onto the heap at its first change.
  */
-template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>>
+template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>, class Sizing = hashing::modulo_sizing>
 class hash_table{
 public:
 	
@@ -24,146 +73,608 @@ public:
 	using comparer = Compare;
 	
 	//Constructors/Destructor
-	hash_table(size_type s = 1) : mu(), size(s >= 1 ? s : 1), capacity(size_type(std::ceil(size * capacity_percentage))), used_size(0), cells(new std::unique_ptr<kv_pair>[size]) {}
+	hash_table(size_type s = 1);
+	template <class RandomIt> hash_table(RandomIt first, RandomIt last, size_type n_threads = 1);
 	hash_table(const hash_table&) = delete;	//No copy ctor because we're not comparing the copy constructors of the lockfree and locking hash tables.
 	hash_table(hash_table&&) = delete;	//Likewise.
-	~hash_table() {delete [] cells;}
+	~hash_table() {delete [] cells; if(!mapped){delete [] controls;}}
 	
 	//Assignment Operators
 	hash_table& operator=(const hash_table&) = delete;
 	hash_table& operator=(hash_table&&) = delete;
 	
 	//Member Functions
-	bool get(const key_type& key, value_type& ret_value) const;
-	void set(const key_type& key, const value_type& value);
+	bool get(const key_type& key, value_type& ret_value) const {return generic_get(key, hasher()(key), ret_value);}
+	template <class Q, class H = Hash, std::enable_if_t<hashing::is_transparent_v<H, Compare>, int> = 0>
+	bool get(const Q& key, value_type& ret_value) const {return generic_get(key, hasher()(key), ret_value);}
+	bool get_with_hash(std::size_t hash, const key_type& key, value_type& ret_value) const {return generic_get(key, hash, ret_value);}
+	template <class Q, class H = Hash, std::enable_if_t<hashing::is_transparent_v<H, Compare>, int> = 0>
+	bool get_with_hash(std::size_t hash, const Q& key, value_type& ret_value) const {return generic_get(key, hash, ret_value);}
+	template <class F> bool visit(const key_type& key, F&& f) const;
+	void set(const key_type& key, const value_type& value) {insert_or_assign(key, value);}
+	template <class M> bool insert_or_assign(const key_type& key, M&& value) {return generic_insert_or_assign(key, std::forward<M>(value));}
+	template <class M> bool insert_or_assign(key_type&& key, M&& value) {return generic_insert_or_assign(std::move(key), std::forward<M>(value));}
+	template <class... Args> bool emplace(const key_type& key, Args&&... args) {return generic_emplace(key, std::forward<Args>(args)...);}
+	template <class... Args> bool emplace(key_type&& key, Args&&... args) {return generic_emplace(std::move(key), std::forward<Args>(args)...);}
 	void remove(const key_type& key);
+	template <class F> bool update(const key_type& key, F&& f);
+	template <class F> bool compute_if_absent(const key_type& key, F&& f);
+	bool compare_and_set(const key_type& key, const value_type& expected, const value_type& desired);
+	value_type fetch_add(const key_type& key, const value_type& delta);
+	size_type get_batch(const key_type* keys, size_type count, value_type* ret_values, bool* found) const;
+	void set_batch(const key_type* keys, const value_type* values, size_type count);
+	template <class F> void for_each(F&& f) const;
+	template <class F> void parallel_for_each(size_type n_threads, F&& f) const;
+	void save(const std::string& path) const;
+	static hash_table open_mapped(const std::string& path);
 	
 private:
 	
 	//Private Types
 	struct kv_pair;
+	struct snapshot_slot{	//A cell, as it's laid out in a snapshot.
+		key_type key;
+		value_type value;
+	};
+	
+	//Private Constructors
+	explicit hash_table(std::unique_ptr<hashing::mapped_file> file);
 	
 	//Table Data Members
 	mutable std::shared_mutex mu;
 	size_type size;
 	size_type capacity;
-	size_type used_size;
+	size_type used_size;	//Live cells and tombstones.
+	size_type tombstones;
+	hashing::control_byte* controls;	//One per cell, followed by copies of the first group_width - 1 so that a group can be loaded from any cell.
 	std::unique_ptr<kv_pair>* cells;	//We use unique_ptr object to store null kv_pairs.
+	std::unique_ptr<hashing::mapped_file> mapped;	//The snapshot being read from, if any (in which case controls point into it, and cells is null).
+	const snapshot_slot* mapped_slots;
 	
 	//Static Data Members
 	static constexpr float capacity_percentage = 0.7;
 	static constexpr size_type resize_factor = 2;
+	static constexpr size_type group_width = size_type(hashing::control_group::width);
+	static constexpr size_type batch_chunk = 32;	//Keys hashed (and prefetched) ahead of probing in a batch.
 	
 	//Private Member Functions
-	void resize();
+	template <class Q> bool generic_get(const Q& key, std::size_t hash, value_type& ret_value) const;
+	template <class Q> size_type find(const Q& key, std::size_t hash) const;
+	template <class KArg, class M> bool generic_insert_or_assign(KArg&& key, M&& value);
+	template <class KArg, class... Args> bool generic_emplace(KArg&& key, Args&&... args);
+	template <class KArg, class M> bool assign(KArg&& key, std::size_t hash, M&& value);
+	size_type locate(const key_type& key, std::size_t hash, bool& present);
+	void occupy(size_type i, std::size_t hash, std::unique_ptr<kv_pair> pair);
+	template <class F> void for_each_in(size_type part, size_type parts, F& f) const;
+	template <class RandomIt> void bulk_fill(RandomIt first, size_type count, size_type n_threads);
+	void prefetch(std::size_t hash) const;
+	void resize(size_type new_size);
+	void promote();
+	const key_type& key_at(size_type i) const {return mapped_slots != nullptr ? mapped_slots[i].key : cells[i]->key;}
+	const value_type& value_at(size_type i) const {return mapped_slots != nullptr ? mapped_slots[i].value : cells[i]->value;}
+	static size_type capacity_of(size_type table_size) {return std::min(size_type(std::ceil(double(table_size) * capacity_percentage)), table_size - 1);}	//Keeps a cell free even in small tables, which 70% would round up to full.  Tables start with two cells, so this is never zero.
+	static size_type matched_cell(size_type group, unsigned int mask, size_type table_size) {return Sizing::wrap(group + size_type(__builtin_ctz(mask)), table_size);}
+	static void set_control(hashing::control_byte* table_controls, size_type table_size, size_type i, hashing::control_byte c);
 	
 };
 
-template <class K, class V, class Hash, class Compare>
-bool hash_table<K, V, Hash, Compare>::get(const key_type& key, value_type& ret_value) const{
+template <class K, class V, class Hash, class Compare, class Sizing>
+hash_table<K, V, Hash, Compare, Sizing>::hash_table(size_type s) : mu(), size(Sizing::round(s >= 2 ? s : 2)), capacity(capacity_of(size)), used_size(0), tombstones(0), controls(new hashing::control_byte[size + group_width - 1]), cells(nullptr), mapped(), mapped_slots(nullptr){
+	std::fill(controls, controls + size + group_width - 1, hashing::empty_control);
+	try{
+		cells = new std::unique_ptr<kv_pair>[size];
+	}catch(...){
+		delete [] controls;
+		throw;
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class Q>
+bool hash_table<K, V, Hash, Compare, Sizing>::generic_get(const Q& key, std::size_t hash, value_type& ret_value) const{
 	std::shared_lock lk(mu);	//Gains shared access.
 	
-	size_type index = hasher()(key) % size;
-	for(size_type i = 0; i < size; ++i){
-		std::unique_ptr<kv_pair>& cell = cells[(index + i) % size];
-		if(cell){
-			if(!cell->tombstone){
-				if(comparer()(key, cell->key)){
-					ret_value = cell->value;	//Assumes a copy constructor exists.
-					return true;
-				}
-			}
-		}else{
-			return false;
+	size_type i = find(key, hash);
+	if(i < 0){
+		return false;
+	}
+	ret_value = value_at(i);	//Assumes a copy constructor exists.
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class RandomIt>
+hash_table<K, V, Hash, Compare, Sizing>::hash_table(RandomIt first, RandomIt last, size_type n_threads) : hash_table(size_type(std::ceil(double(last - first) / capacity_percentage)) + 1){	//In double, since a float quotient (or product, for the capacity) can round below the count for large ranges.
+	bulk_fill(first, size_type(last - first), n_threads);
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Sizing>::visit(const key_type& key, F&& f) const{
+	std::shared_lock lk(mu);	//Gains shared access.
+	
+	size_type i = find(key, hasher()(key));
+	if(i < 0){
+		return false;
+	}
+	f(value_at(i));
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class KArg, class M>
+bool hash_table<K, V, Hash, Compare, Sizing>::generic_insert_or_assign(KArg&& key, M&& value){
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	std::size_t hash = hasher()(key);
+	return assign(std::forward<KArg>(key), hash, std::forward<M>(value));
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class KArg, class... Args>
+bool hash_table<K, V, Hash, Compare, Sizing>::generic_emplace(KArg&& key, Args&&... args){
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	std::size_t hash = hasher()(key);
+	bool present;
+	size_type i = locate(key, hash, present);
+	if(present){
+		return false;
+	}
+	occupy(i, hash, std::make_unique<kv_pair>(std::forward<KArg>(key), std::forward<Args>(args)...));
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::remove(const key_type& key){
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	promote();
+	size_type i = find(key, hasher()(key));
+	if(i < 0){
+		return;
+	}
+	
+	cells[i].reset();
+	if(controls[Sizing::wrap(i + 1, size)] == hashing::empty_control){
+		set_control(controls, size, i, hashing::empty_control);	//No probe passes through a cell followed by an empty one, so it needn't be a tombstone.
+		--used_size;
+	}else{
+		set_control(controls, size, i, hashing::tombstone_control);
+		if(++tombstones * 2 >= capacity){
+			resize(size);	//Rehashing at the same size clears the tombstones.
 		}
 	}
-	return false;
 }
 
-template <class K, class V, class Hash, class Compare>
-void hash_table<K, V, Hash, Compare>::set(const key_type& key, const value_type& value){
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Sizing>::update(const key_type& key, F&& f){	//f is given the value to change, returns whether the key was present.
 	std::unique_lock lk(mu);	//Gains exclusive access.
 	
-	if(used_size >= capacity){
-		resize();
+	promote();
+	size_type i = find(key, hasher()(key));
+	if(i < 0){
+		return false;
+	}
+	f(cells[i]->value);
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class F>
+bool hash_table<K, V, Hash, Compare, Sizing>::compute_if_absent(const key_type& key, F&& f){	//f makes the value to insert, returns whether it was inserted.
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	std::size_t hash = hasher()(key);
+	bool present;
+	size_type i = locate(key, hash, present);
+	if(present){
+		return false;
+	}
+	occupy(i, hash, std::make_unique<kv_pair>(key, f()));
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+bool hash_table<K, V, Hash, Compare, Sizing>::compare_and_set(const key_type& key, const value_type& expected, const value_type& desired){
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	promote();
+	size_type i = find(key, hasher()(key));
+	if(i < 0 || !(cells[i]->value == expected)){	//Assumes an equality operator exists.
+		return false;
 	}
+	cells[i]->value = desired;
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+typename hash_table<K, V, Hash, Compare, Sizing>::value_type hash_table<K, V, Hash, Compare, Sizing>::fetch_add(const key_type& key, const value_type& delta){	//Absent keys count as zero, returns the value before the addition.
+	static_assert(std::is_arithmetic_v<value_type>, "fetch_add needs an arithmetic value_type.");
+	std::unique_lock lk(mu);	//Gains exclusive access.
 	
-	size_type index = hasher()(key) % size;
-	for(size_type i = 0; i < size; ++i){
-		std::unique_ptr<kv_pair>& cell = cells[(index + i) % size];
-		if(cell){
-			if(comparer()(key, cell->key)){
-				cell->value = value;
-				return;
+	std::size_t hash = hasher()(key);
+	bool present;
+	size_type i = locate(key, hash, present);
+	if(present){
+		value_type old_value = cells[i]->value;
+		cells[i]->value += delta;
+		return old_value;
+	}
+	occupy(i, hash, std::make_unique<kv_pair>(key, delta));
+	return value_type();
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+typename hash_table<K, V, Hash, Compare, Sizing>::size_type hash_table<K, V, Hash, Compare, Sizing>::get_batch(const key_type* keys, size_type count, value_type* ret_values, bool* found) const{
+	std::shared_lock lk(mu);	//Gains shared access once for the whole batch.
+	
+	size_type found_count = 0;
+	std::size_t hashes[batch_chunk];
+	for(size_type first = 0; first < count; first += batch_chunk){
+		size_type n = std::min(count - first, batch_chunk);
+		for(size_type i = 0; i < n; ++i){	//Hashing every key first gives the prefetches time to land before the probes.
+			hashes[i] = hasher()(keys[first + i]);
+			prefetch(hashes[i]);
+		}
+		for(size_type i = 0; i < n; ++i){
+			size_type j = find(keys[first + i], hashes[i]);
+			found[first + i] = j >= 0;
+			if(j >= 0){
+				ret_values[first + i] = value_at(j);
+				++found_count;
 			}
+		}
+	}
+	return found_count;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::set_batch(const key_type* keys, const value_type* values, size_type count){
+	std::unique_lock lk(mu);	//Gains exclusive access once for the whole batch.
+	
+	std::size_t hashes[batch_chunk];
+	for(size_type first = 0; first < count; first += batch_chunk){
+		size_type n = std::min(count - first, batch_chunk);
+		for(size_type i = 0; i < n; ++i){
+			hashes[i] = hasher()(keys[first + i]);
+			prefetch(hashes[i]);	//Only a hint, so it doesn't matter if an insert below resizes the table.
+		}
+		for(size_type i = 0; i < n; ++i){
+			assign(keys[first + i], hashes[i], values[first + i]);
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class F>
+void hash_table<K, V, Hash, Compare, Sizing>::for_each(F&& f) const{	//f is given each key and value.
+	std::shared_lock lk(mu);	//Gains shared access.
+	
+	for_each_in(0, 1, f);
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class F>
+void hash_table<K, V, Hash, Compare, Sizing>::parallel_for_each(size_type n_threads, F&& f) const{	//f is called from several threads at once, and mustn't throw.
+	std::shared_lock lk(mu);	//Gains shared access, on behalf of every worker.
+	
+	if(n_threads < 1){
+		n_threads = 1;
+	}
+	std::vector<std::thread> workers;
+	workers.reserve(n_threads - 1);
+	for(size_type i = 1; i < n_threads; ++i){
+		workers.emplace_back([this, i, n_threads, &f](){for_each_in(i, n_threads, f);});
+	}
+	for_each_in(0, n_threads, f);
+	for(auto i = workers.begin(); i != workers.end(); ++i){
+		i->join();
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::save(const std::string& path) const{	//Overwrites the file, throws if it can't be written.
+	static_assert(std::is_trivially_copyable_v<key_type> && std::is_trivially_copyable_v<value_type>, "Snapshots need trivially copyable keys and values.");
+	std::shared_lock lk(mu);	//Gains shared access.
+	
+	hashing::snapshot_header header{};
+	std::memcpy(header.magic, hashing::snapshot_magic, sizeof(header.magic));
+	header.version = hashing::snapshot_version;
+	header.key_size = sizeof(key_type);
+	header.value_size = sizeof(value_type);
+	header.slot_size = sizeof(snapshot_slot);
+	header.size = std::uint64_t(size);
+	header.capacity = std::uint64_t(capacity);
+	header.used_size = std::uint64_t(used_size);
+	header.tombstones = std::uint64_t(tombstones);
+	header.hash_check = std::uint64_t(hasher()(key_type()));
+	header.home_check = std::uint64_t(Sizing::home(std::size_t(0x9E3779B97F4A7C15ull), size));
+	header.controls_offset = hashing::snapshot_align(sizeof(header));
+	header.slots_offset = hashing::snapshot_align(header.controls_offset + size + group_width - 1);
+	
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	const char padding[hashing::snapshot_alignment] = {};
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(padding, std::streamsize(header.controls_offset - sizeof(header)));
+	out.write(reinterpret_cast<const char*>(controls), size + group_width - 1);
+	out.write(padding, std::streamsize(header.slots_offset - header.controls_offset - (size + group_width - 1)));
+	const char empty_slot[sizeof(snapshot_slot)] = {};
+	for(size_type i = 0; i < size && out; ++i){
+		if(controls[i] >= 0){
+			snapshot_slot slot{key_at(i), value_at(i)};
+			out.write(reinterpret_cast<const char*>(&slot), sizeof(slot));
 		}else{
-			++used_size;
-			cells[(index + i) % size] = std::make_unique<kv_pair>(key, value, false);
-			return;
+			out.write(empty_slot, sizeof(empty_slot));
 		}
 	}
+	out.flush();
+	if(!out){
+		throw std::runtime_error("Couldn't write a snapshot to " + path);
+	}
 }
 
-template <class K, class V, class Hash, class Compare>
-void hash_table<K, V, Hash, Compare>::remove(const key_type& key){
-	std::unique_lock lk(mu);	//Gains exclusive access.
+template <class K, class V, class Hash, class Compare, class Sizing>
+hash_table<K, V, Hash, Compare, Sizing> hash_table<K, V, Hash, Compare, Sizing>::open_mapped(const std::string& path){	//Throws if the file can't be mapped, or wasn't saved by this kind of table.
+	static_assert(std::is_trivially_copyable_v<key_type> && std::is_trivially_copyable_v<value_type>, "Snapshots need trivially copyable keys and values.");
+	return hash_table(std::make_unique<hashing::mapped_file>(path));
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+hash_table<K, V, Hash, Compare, Sizing>::hash_table(std::unique_ptr<hashing::mapped_file> file) : mu(), size(0), capacity(0), used_size(0), tombstones(0), controls(nullptr), cells(nullptr), mapped(std::move(file)), mapped_slots(nullptr){
+	hashing::snapshot_header header;
+	if(mapped->length() < sizeof(header)){
+		throw std::runtime_error("Not a hash table snapshot.");
+	}
+	std::memcpy(&header, mapped->data(), sizeof(header));
+	if(std::memcmp(header.magic, hashing::snapshot_magic, sizeof(header.magic)) != 0 || header.version != hashing::snapshot_version){
+		throw std::runtime_error("Not a hash table snapshot (or one from another version).");
+	}
+	if(header.key_size != sizeof(key_type) || header.value_size != sizeof(value_type) || header.slot_size != sizeof(snapshot_slot)){
+		throw std::runtime_error("The snapshot's keys or values are of another type.");
+	}
+	if(header.size < 1 || header.size > std::uint64_t(std::numeric_limits<size_type>::max()) || header.capacity == 0 || header.capacity >= header.size || header.used_size > header.size || header.tombstones > header.used_size
+		|| header.controls_offset % hashing::snapshot_alignment != 0 || header.slots_offset % hashing::snapshot_alignment != 0
+		|| header.controls_offset < sizeof(header) || header.slots_offset < header.controls_offset + header.size + group_width - 1
+		|| mapped->length() < header.slots_offset + header.size * sizeof(snapshot_slot)){
+		throw std::runtime_error("The snapshot is damaged or truncated.");
+	}
+	size = size_type(header.size);
+	if(Sizing::round(size) != size || header.hash_check != std::uint64_t(hasher()(key_type())) || header.home_check != std::uint64_t(Sizing::home(std::size_t(0x9E3779B97F4A7C15ull), size))){
+		throw std::runtime_error("The snapshot was saved with another hasher or sizing policy.");
+	}
+	capacity = size_type(header.capacity);
+	used_size = size_type(header.used_size);
+	tombstones = size_type(header.tombstones);
+	controls = const_cast<hashing::control_byte*>(reinterpret_cast<const hashing::control_byte*>(mapped->data() + header.controls_offset));	//Never written through until promote replaces it.
+	mapped_slots = reinterpret_cast<const snapshot_slot*>(mapped->data() + header.slots_offset);
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class F>
+void hash_table<K, V, Hash, Compare, Sizing>::for_each_in(size_type part, size_type parts, F& f) const{	//Assumes the caller holds the lock, visits the given part of the cells.
+	size_type first = size_type(std::int64_t(size) * part / parts), last = size_type(std::int64_t(size) * (part + 1) / parts);
+	for(size_type i = first; i < last; ++i){
+		if(controls[i] >= 0){	//Full cells are the only ones with a tag.
+			f(key_at(i), value_at(i));
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class RandomIt>
+void hash_table<K, V, Hash, Compare, Sizing>::bulk_fill(RandomIt first, size_type count, size_type n_threads){	//Assumes the table is empty, and that nobody else can use it yet.
+	std::size_t parts = std::size_t(std::max(1, std::min(n_threads, size)));
+	auto slices = hashing::partition(count, parts, [&](std::size_t i){return hasher()(first[i].first);}, [&](std::size_t hash){return hashing::region_of(Sizing::home(hash, size), size, parts);});
+	std::vector<std::vector<hashing::bulk_entry>> overflow(parts);
+	std::vector<size_type> filled(parts, 0);
 	
-	size_type index = hasher()(key) % size;
-	for(size_type i = 0; i < size; ++i){
-		std::unique_ptr<kv_pair>& cell = cells[(index + i) % size];
-		if(cell){
-			if(comparer()(key, cell->key)){
-				cell->tombstone = true;
-				return;
+	hashing::run_parallel(parts, [&](std::size_t region){	//Each thread only touches the cells (and control bytes) of its own region.
+		size_type end = size_type(hashing::region_begin(region + 1, size, parts));
+		for(std::size_t slice = 0; slice < parts; ++slice){
+			for(const hashing::bulk_entry& entry : slices[slice][region]){
+				const auto& pair = first[entry.index];
+				hashing::control_byte tag = hashing::tag_of(entry.hash);
+				size_type i = Sizing::home(entry.hash, size);
+				for(; i < end; ++i){
+					if(controls[i] == hashing::empty_control){
+						cells[i] = std::make_unique<kv_pair>(pair.first, pair.second);
+						set_control(controls, size, i, tag);
+						++filled[region];
+						break;
+					}else if(controls[i] == tag && comparer()(pair.first, cells[i]->key)){
+						cells[i]->value = pair.second;
+						break;
+					}
+				}
+				if(i == end){
+					overflow[region].push_back(entry);	//Its probe continues into the next region.
+				}
 			}
 		}
+	});
+	
+	for(size_type region_filled : filled){
+		used_size += region_filled;
+	}
+	for(auto region = overflow.begin(); region != overflow.end(); ++region){	//Once a key overflows, its later duplicates do too, so they're still inserted in order.
+		for(const hashing::bulk_entry& entry : *region){
+			assign(first[entry.index].first, entry.hash, first[entry.index].second);
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class Q>
+typename hash_table<K, V, Hash, Compare, Sizing>::size_type hash_table<K, V, Hash, Compare, Sizing>::find(const Q& key, std::size_t hash) const{	//Assumes the caller holds the lock, returns -1 if the key is absent.
+	hashing::control_byte tag = hashing::tag_of(hash);
+	size_type index = Sizing::home(hash, size);
+	for(size_type i = 0; i < size; i += group_width){
+		size_type group = Sizing::wrap(index + i, size);
+		hashing::control_group controls_group(controls + group);
+		for(unsigned int mask = controls_group.match(tag); mask != 0; mask &= mask - 1){
+			size_type j = matched_cell(group, mask, size);
+			if(comparer()(key, key_at(j))){
+				return j;
+			}
+		}
+		if(controls_group.match_empty() != 0){
+			return -1;	//Keys are never placed past an empty cell on their probe.
+		}
+	}
+	return -1;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+template <class KArg, class M>
+bool hash_table<K, V, Hash, Compare, Sizing>::assign(KArg&& key, std::size_t hash, M&& value){	//Assumes the caller holds an exclusive lock.
+	bool present;
+	size_type i = locate(key, hash, present);
+	if(present){
+		cells[i]->value = std::forward<M>(value);
+		return false;
 	}
+	occupy(i, hash, std::make_unique<kv_pair>(std::forward<KArg>(key), std::forward<M>(value)));
+	return true;
 }
 
-template <class K, class V, class Hash, class Compare>
-void hash_table<K, V, Hash, Compare>::resize(){	//Assumes that the resizing thread has already obtained an exclusive lock.
-	size_type old_size = size;
-	size *= resize_factor;
-	capacity = size_type(std::ceil(capacity_percentage * size));
+template <class K, class V, class Hash, class Compare, class Sizing>
+typename hash_table<K, V, Hash, Compare, Sizing>::size_type hash_table<K, V, Hash, Compare, Sizing>::locate(const key_type& key, std::size_t hash, bool& present){	//Assumes the caller holds an exclusive lock, returns the key's cell or else the cell to insert it into.
+	promote();
+	if(used_size >= capacity){
+		resize(size * resize_factor);
+	}
 	
-	std::unique_ptr<kv_pair>* new_cells = new std::unique_ptr<kv_pair>[size];
+	hashing::control_byte tag = hashing::tag_of(hash);
+	size_type index = Sizing::home(hash, size), target = -1;
+	for(size_type i = 0; i < size; i += group_width){
+		size_type group = Sizing::wrap(index + i, size);
+		hashing::control_group controls_group(controls + group);
+		for(unsigned int mask = controls_group.match(tag); mask != 0; mask &= mask - 1){
+			size_type j = matched_cell(group, mask, size);
+			if(comparer()(key, cells[j]->key)){
+				present = true;
+				return j;
+			}
+		}
+		if(target < 0 && controls_group.match_free() != 0){
+			target = matched_cell(group, controls_group.match_free(), size);	//The key may still be further along, so keep probing before using this.
+		}
+		if(controls_group.match_empty() != 0){
+			break;
+		}
+	}
+	present = false;
+	return target;	//Since used_size < capacity < size, there was either an empty cell or a tombstone.
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::occupy(size_type i, std::size_t hash, std::unique_ptr<kv_pair> pair){	//Fills a free cell found by locate, once nothing else can throw.
+	cells[i] = std::move(pair);
+	if(controls[i] == hashing::empty_control){
+		++used_size;
+	}else{
+		--tombstones;
+	}
+	set_control(controls, size, i, hashing::tag_of(hash));
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::prefetch(std::size_t hash) const{
+	size_type index = Sizing::home(hash, size);
+	__builtin_prefetch(controls + index);
+	if(mapped_slots != nullptr){
+		__builtin_prefetch(mapped_slots + index);
+	}else{
+		__builtin_prefetch(cells + index);
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::resize(size_type new_size){	//Assumes that the resizing thread has already obtained an exclusive lock.
+	hashing::control_byte* new_controls = new hashing::control_byte[new_size + group_width - 1];
+	std::unique_ptr<kv_pair>* new_cells = nullptr;
 	try{
-		for(size_type i = 0; i < old_size; ++i){
-			std::unique_ptr<kv_pair>& cell = cells[i];
-			if(cell){
-				if(!cell->tombstone){
-					size_type index = hasher()(cell->key) % size;
-					for(size_type j = 0; j < size; ++j){
-						std::unique_ptr<kv_pair>& new_cell = new_cells[(index + j) % size];
-						if(!new_cell){
-							new_cells[(index + j) % size] = std::make_unique<kv_pair>(cell->key, cell->value, false);
-							break;
-						}
-					}
-				}else{
-					--used_size;
+		new_cells = new std::unique_ptr<kv_pair>[new_size];
+	}catch(...){
+		delete [] new_controls;
+		throw;
+	}
+	std::fill(new_controls, new_controls + new_size + group_width - 1, hashing::empty_control);
+	
+	for(size_type i = 0; i < size; ++i){	//Pairs are moved rather than copied, so nothing below throws.
+		if(cells[i]){
+			std::size_t hash = hasher()(cells[i]->key);
+			size_type index = Sizing::home(hash, new_size);
+			for(size_type j = 0; j < new_size; j += group_width){
+				size_type group = Sizing::wrap(index + j, new_size);
+				unsigned int mask = hashing::control_group(new_controls + group).match_empty();
+				if(mask != 0){
+					size_type k = matched_cell(group, mask, new_size);
+					new_cells[k] = std::move(cells[i]);
+					set_control(new_controls, new_size, k, hashing::tag_of(hash));
+					break;
 				}
 			}
 		}
+	}
+	
+	delete [] cells;
+	delete [] controls;
+	cells = new_cells;
+	controls = new_controls;
+	size = new_size;
+	capacity = capacity_of(size);
+	used_size -= tombstones;
+	tombstones = 0;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::promote(){	//Assumes the caller holds an exclusive lock, copies a mapped snapshot onto the heap so that it can be changed.
+	if(!mapped){
+		return;
+	}
+	hashing::control_byte* new_controls = new hashing::control_byte[size + group_width - 1];
+	std::unique_ptr<kv_pair>* new_cells = nullptr;
+	try{
+		new_cells = new std::unique_ptr<kv_pair>[size];
+		for(size_type i = 0; i < size; ++i){
+			if(controls[i] >= 0){
+				new_cells[i] = std::make_unique<kv_pair>(mapped_slots[i].key, mapped_slots[i].value);
+			}
+		}
 	}catch(...){
 		delete [] new_cells;
+		delete [] new_controls;
 		throw;
 	}
+	std::copy(controls, controls + size + group_width - 1, new_controls);
 	
-	delete [] cells;
+	controls = new_controls;
 	cells = new_cells;
+	mapped_slots = nullptr;
+	mapped.reset();
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void hash_table<K, V, Hash, Compare, Sizing>::set_control(hashing::control_byte* table_controls, size_type table_size, size_type i, hashing::control_byte c){
+	table_controls[i] = c;
+	for(size_type j = i; j < group_width - 1; j += table_size){	//Tables smaller than a group have several copies of a control byte.
+		table_controls[table_size + j] = c;
+	}
 }
 
 /*
  * A key-value data structure used to store info about
  * keys and values in a hash_table.
  */
-template <class K, class V, class Hash, class Compare>
-struct hash_table<K, V, Hash, Compare>::kv_pair{
+template <class K, class V, class Hash, class Compare, class Sizing>
+struct hash_table<K, V, Hash, Compare, Sizing>::kv_pair{
 	
 	//Constructors/Destructor
 	kv_pair() = delete;
-	kv_pair(const key_type& k, const value_type& v, bool t) : key(k), value(v), tombstone(t) {}
+	template <class KArg, class... Args> kv_pair(KArg&& k, Args&&... args) : key(std::forward<KArg>(k)), value(std::forward<Args>(args)...) {}
 	kv_pair(const kv_pair&) = delete;
 	kv_pair(kv_pair&&) = delete;
 	~kv_pair() = default;
@@ -175,7 +686,6 @@ struct hash_table<K, V, Hash, Compare>::kv_pair{
 	//Data Members
 	key_type key;
 	value_type value;
-	bool tombstone;
 	
 };
 
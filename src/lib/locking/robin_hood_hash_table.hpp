@@ -0,0 +1,177 @@
+#ifndef LOCKING_ROBIN_HOOD_HASH_TABLE_H_INCLUDED
+#define LOCKING_ROBIN_HOOD_HASH_TABLE_H_INCLUDED
+
+#include <cmath>
+#include <mutex>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <shared_mutex>
+#include "../hashing/sizing.hpp"
+
+namespace locking{
+
+/*
+ * A thread-safe locking hash table using Robin Hood probing.
+ *
+ * Every cell remembers how far its pair is from its home cell, and an
+ * insert takes the cell of any pair closer to home than itself (pushing
+ * that pair further along).  Hence probe lengths stay short and even
+ * at higher loads, and a lookup can stop as soon as it passes a pair
+ * closer to home than it would be.  Removes shift the following pairs
+ * back a cell instead of leaving tombstones.
+ */
+template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>, class Sizing = hashing::modulo_sizing>
+class robin_hood_hash_table{
+public:
+	
+	//Public Types
+	using size_type = int;
+	using key_type = K;
+	using value_type = V;
+	using hasher = Hash;
+	using comparer = Compare;
+	
+	//Constructors/Destructor
+	robin_hood_hash_table(size_type s = 1) : mu(), size(Sizing::round(s >= 1 ? s : 1)), capacity(capacity_of(size)), used_size(0), cells(new cell[size]) {}
+	robin_hood_hash_table(const robin_hood_hash_table&) = delete;	//Same as hash_table.
+	robin_hood_hash_table(robin_hood_hash_table&&) = delete;
+	~robin_hood_hash_table() {delete [] cells;}
+	
+	//Assignment Operators
+	robin_hood_hash_table& operator=(const robin_hood_hash_table&) = delete;
+	robin_hood_hash_table& operator=(robin_hood_hash_table&&) = delete;
+	
+	//Member Functions
+	bool get(const key_type& key, value_type& ret_value) const;
+	void set(const key_type& key, const value_type& value);
+	void remove(const key_type& key);
+	
+private:
+	
+	//Private Types
+	struct kv_pair{
+		key_type key;
+		value_type value;
+	};
+	struct cell{
+		size_type distance = -1;	//How far the pair is from its home cell, -1 when there's no pair.
+		std::unique_ptr<kv_pair> pair;
+	};
+	
+	//Table Data Members
+	mutable std::shared_mutex mu;
+	size_type size;
+	size_type capacity;
+	size_type used_size;
+	cell* cells;
+	
+	//Static Data Members
+	static constexpr float capacity_percentage = 0.9;	//Robin Hood probing keeps probes short enough to fill the table further.
+	static constexpr size_type resize_factor = 2;
+	
+	//Private Member Functions
+	size_type find(const key_type& key) const;
+	void resize();
+	static void place(cell* table_cells, size_type table_size, std::unique_ptr<kv_pair> pair);
+	static size_type capacity_of(size_type table_size) {return std::min(size_type(std::ceil(table_size * capacity_percentage)), table_size - 1);}	//At 90%, small tables would round up to full, so at least one cell is always kept free.
+	
+};
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+bool robin_hood_hash_table<K, V, Hash, Compare, Sizing>::get(const key_type& key, value_type& ret_value) const{
+	std::shared_lock lk(mu);	//Gains shared access.
+	
+	size_type i = find(key);
+	if(i < 0){
+		return false;
+	}
+	ret_value = cells[i].pair->value;	//Assumes a copy constructor exists.
+	return true;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void robin_hood_hash_table<K, V, Hash, Compare, Sizing>::set(const key_type& key, const value_type& value){
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	size_type i = find(key);
+	if(i >= 0){
+		cells[i].pair->value = value;
+		return;
+	}
+	
+	if(used_size >= capacity){
+		resize();
+	}
+	place(cells, size, std::make_unique<kv_pair>(kv_pair{key, value}));	//Since used_size < capacity <= size, there's always an empty cell.
+	++used_size;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void robin_hood_hash_table<K, V, Hash, Compare, Sizing>::remove(const key_type& key){
+	std::unique_lock lk(mu);	//Gains exclusive access.
+	
+	size_type i = find(key);
+	if(i < 0){
+		return;
+	}
+	
+	for(size_type j = Sizing::wrap(i + 1, size); cells[j].distance > 0; i = j, j = Sizing::wrap(j + 1, size)){	//Shift the pairs after it back until one is already home (or there's a gap).
+		cells[i].pair = std::move(cells[j].pair);
+		cells[i].distance = cells[j].distance - 1;
+	}
+	cells[i].pair.reset();
+	cells[i].distance = -1;
+	--used_size;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+typename robin_hood_hash_table<K, V, Hash, Compare, Sizing>::size_type robin_hood_hash_table<K, V, Hash, Compare, Sizing>::find(const key_type& key) const{	//Assumes the caller holds the lock, returns -1 if the key is absent.
+	size_type index = Sizing::home(hasher()(key), size);
+	for(size_type distance = 0; distance < size; ++distance){
+		const cell& c = cells[Sizing::wrap(index + distance, size)];
+		if(c.distance < distance){
+			return -1;	//Our key would have taken this cell, so it can't be any further along.
+		}else if(c.distance == distance && comparer()(key, c.pair->key)){	//Only pairs with the same home cell can have the same key.
+			return Sizing::wrap(index + distance, size);
+		}
+	}
+	return -1;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void robin_hood_hash_table<K, V, Hash, Compare, Sizing>::resize(){	//Assumes that the resizing thread has already obtained an exclusive lock.
+	size_type new_size = size * resize_factor;
+	cell* new_cells = new cell[new_size];	//Nothing below throws, so this is the only allocation which can fail.
+	for(size_type i = 0; i < size; ++i){
+		if(cells[i].distance >= 0){
+			place(new_cells, new_size, std::move(cells[i].pair));
+		}
+	}
+	
+	delete [] cells;
+	cells = new_cells;
+	size = new_size;
+	capacity = capacity_of(size);
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void robin_hood_hash_table<K, V, Hash, Compare, Sizing>::place(cell* table_cells, size_type table_size, std::unique_ptr<kv_pair> pair){	//Inserts a key known to be absent, assumes there's an empty cell.
+	size_type distance = 0;
+	for(size_type i = Sizing::home(hasher()(pair->key), table_size);; i = Sizing::wrap(i + 1, table_size), ++distance){
+		cell& c = table_cells[i];
+		if(c.distance < 0){
+			c.distance = distance;
+			c.pair = std::move(pair);
+			return;
+		}else if(c.distance < distance){	//Take from the rich (pairs near home) and give to the poor.
+			std::swap(c.distance, distance);
+			std::swap(c.pair, pair);
+		}
+	}
+}
+
+}
+
+#endif
\ No newline at end of file
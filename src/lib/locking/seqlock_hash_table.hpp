@@ -0,0 +1,296 @@
+#ifndef LOCKING_SEQLOCK_HASH_TABLE_H_INCLUDED
+#define LOCKING_SEQLOCK_HASH_TABLE_H_INCLUDED
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include "../hashing/sizing.hpp"
+
+namespace locking{
+
+/*
+ * A thread-safe locking hash table whose readers never write shared memory.
+ *
+ * Writers (and resizes) serialize on a mutex and bump a sequence counter
+ * before and after every change.  Readers probe optimistically, then
+ * check that the counter is even and hasn't moved.  If it has, they retry.
+ *
+ * Cells are read while writers may be changing them, so keys and values
+ * live in atomics and must be trivially copyable.  Arrays replaced by a
+ * resize are kept until the table is destroyed.  Growth is geometric, so
+ * together they're smaller than the current array, and a reader racing
+ * a resize never touches freed memory.
+ *
+ * Inserts reuse tombstones as in hash_table, but compaction rehashes the
+ * array in place (inside one write), so it never retains another array.
+ */
+template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>, class Sizing = hashing::modulo_sizing>
+class seqlock_hash_table{
+public:
+	
+	static_assert(std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<V>, "seqlock_hash_table keys and values must be trivially copyable.");
+	
+	//Public Types
+	using size_type = int;
+	using key_type = K;
+	using value_type = V;
+	using hasher = Hash;
+	using comparer = Compare;
+	
+	//Constructors/Destructor
+	seqlock_hash_table(size_type s = 1) : mu(), sequence(0), capacity(0), used_size(0), tombstones(0), cells(new storage(s >= 1 ? s : 1, nullptr)) {capacity = size_type(std::ceil(cells.load()->size * capacity_percentage));}
+	seqlock_hash_table(const seqlock_hash_table&) = delete;	//Same as hash_table.
+	seqlock_hash_table(seqlock_hash_table&&) = delete;
+	~seqlock_hash_table();
+	
+	//Assignment Operators
+	seqlock_hash_table& operator=(const seqlock_hash_table&) = delete;
+	seqlock_hash_table& operator=(seqlock_hash_table&&) = delete;
+	
+	//Member Functions
+	bool get(const key_type& key, value_type& ret_value) const;
+	void set(const key_type& key, const value_type& value);
+	void remove(const key_type& key);
+	
+private:
+	
+	//Private Types
+	enum cell_state : unsigned char{
+		empty,
+		live,
+		tombstone
+	};
+	struct cell{
+		std::atomic<cell_state> state;
+		std::atomic<key_type> key;
+		std::atomic<value_type> value;
+	};
+	struct storage;
+	
+	//Table Data Members
+	std::mutex mu;	//Only taken by writers.
+	std::atomic<unsigned long> sequence;	//Odd while a writer is changing the table.
+	size_type capacity;
+	size_type used_size;	//Live cells and tombstones.
+	size_type tombstones;
+	std::atomic<storage*> cells;
+	
+	//Static Data Members
+	static constexpr float capacity_percentage = 0.7;
+	static constexpr size_type resize_factor = 2;
+	
+	//Private Member Functions
+	void begin_write() {sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); std::atomic_thread_fence(std::memory_order_release);}
+	void end_write() {sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);}
+	void resize();
+	void compact();
+	static void place(storage& s, const key_type& key, const value_type& value);
+	
+};
+
+/*
+ * A cell array along with its size, so that readers always see the two together.
+ */
+template <class K, class V, class Hash, class Compare, class Sizing>
+struct seqlock_hash_table<K, V, Hash, Compare, Sizing>::storage{
+	
+	//Constructors/Destructor
+	storage(size_type s, storage* p);
+	storage(const storage&) = delete;
+	storage(storage&&) = delete;
+	~storage() {delete [] slots;}
+	
+	//Assignment Operators
+	storage& operator=(const storage&) = delete;
+	storage& operator=(storage&&) = delete;
+	
+	//Data Members
+	const size_type size;
+	cell* const slots;
+	storage* const previous;	//The array this one replaced, kept for any readers still probing it.
+	
+};
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+seqlock_hash_table<K, V, Hash, Compare, Sizing>::storage::storage(size_type s, storage* p) : size(Sizing::round(s)), slots(new cell[size]), previous(p){
+	for(size_type i = 0; i < size; ++i){
+		slots[i].state.store(empty, std::memory_order_relaxed);
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+seqlock_hash_table<K, V, Hash, Compare, Sizing>::~seqlock_hash_table(){
+	storage* s = cells.load();
+	while(s != nullptr){
+		storage* p = s->previous;
+		delete s;
+		s = p;
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+bool seqlock_hash_table<K, V, Hash, Compare, Sizing>::get(const key_type& key, value_type& ret_value) const{
+	while(true){
+		unsigned long before = sequence.load(std::memory_order_acquire);
+		if(before % 2 == 0){
+			const storage* s = cells.load(std::memory_order_acquire);
+			bool found = false;
+			value_type found_value{};
+			
+			size_type index = Sizing::home(hasher()(key), s->size);
+			for(size_type i = 0; i < s->size; ++i){
+				const cell& c = s->slots[Sizing::wrap(index + i, s->size)];
+				cell_state state = c.state.load(std::memory_order_relaxed);
+				if(state == empty){
+					break;
+				}else if(state == live && comparer()(key, c.key.load(std::memory_order_relaxed))){
+					found_value = c.value.load(std::memory_order_relaxed);
+					found = true;
+					break;
+				}
+			}
+			
+			std::atomic_thread_fence(std::memory_order_acquire);	//Keeps the probe's loads from moving past the check below.
+			if(sequence.load(std::memory_order_relaxed) == before){
+				if(found){
+					ret_value = found_value;
+				}
+				return found;
+			}
+		}
+		std::this_thread::yield();	//A writer is (or was) active, give it a chance to finish.
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void seqlock_hash_table<K, V, Hash, Compare, Sizing>::set(const key_type& key, const value_type& value){
+	std::unique_lock lk(mu);
+	
+	if(used_size >= capacity){
+		resize();
+	}
+	
+	storage* s = cells.load(std::memory_order_relaxed);
+	size_type index = Sizing::home(hasher()(key), s->size);
+	cell* target = nullptr;
+	for(size_type i = 0; i < s->size; ++i){
+		cell& c = s->slots[Sizing::wrap(index + i, s->size)];
+		cell_state state = c.state.load(std::memory_order_relaxed);
+		if(state == empty){
+			if(target == nullptr){
+				target = &c;
+				++used_size;
+			}
+			break;
+		}else if(comparer()(key, c.key.load(std::memory_order_relaxed))){
+			if(target != nullptr){
+				++tombstones;	//The tombstone we were going to reuse stays one.
+			}
+			if(state == tombstone){
+				--tombstones;	//Revives a removed key.
+			}
+			target = &c;
+			break;
+		}else if(state == tombstone && target == nullptr){
+			target = &c;	//The key may still be further along, so keep probing before reusing this.
+			--tombstones;
+		}
+	}
+	
+	begin_write();	//Since used_size < capacity < size, there was either an empty cell or a tombstone.
+	target->key.store(key, std::memory_order_relaxed);
+	target->value.store(value, std::memory_order_relaxed);
+	target->state.store(live, std::memory_order_relaxed);
+	end_write();
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void seqlock_hash_table<K, V, Hash, Compare, Sizing>::remove(const key_type& key){
+	std::unique_lock lk(mu);
+	
+	storage* s = cells.load(std::memory_order_relaxed);
+	size_type index = Sizing::home(hasher()(key), s->size);
+	for(size_type i = 0; i < s->size; ++i){
+		cell& c = s->slots[Sizing::wrap(index + i, s->size)];
+		cell_state state = c.state.load(std::memory_order_relaxed);
+		if(state == empty){
+			return;
+		}else if(state == live && comparer()(key, c.key.load(std::memory_order_relaxed))){
+			begin_write();
+			c.state.store(tombstone, std::memory_order_relaxed);
+			end_write();
+			if(++tombstones * 2 >= capacity){
+				compact();
+			}
+			return;
+		}
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void seqlock_hash_table<K, V, Hash, Compare, Sizing>::resize(){	//Assumes that the resizing thread has already locked mu.
+	storage* old_cells = cells.load(std::memory_order_relaxed);
+	storage* new_cells = new storage(old_cells->size * resize_factor, old_cells);
+	capacity = size_type(std::ceil(capacity_percentage * new_cells->size));
+	
+	used_size = 0;
+	tombstones = 0;
+	for(size_type i = 0; i < old_cells->size; ++i){	//Nobody else can see new_cells yet, so it can be filled in without bumping the sequence.
+		const cell& c = old_cells->slots[i];
+		if(c.state.load(std::memory_order_relaxed) == live){
+			place(*new_cells, c.key.load(std::memory_order_relaxed), c.value.load(std::memory_order_relaxed));
+			++used_size;
+		}
+	}
+	
+	begin_write();
+	cells.store(new_cells, std::memory_order_release);
+	end_write();
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void seqlock_hash_table<K, V, Hash, Compare, Sizing>::compact(){	//Assumes that the compacting thread has already locked mu.
+	storage* s = cells.load(std::memory_order_relaxed);
+	std::vector<std::pair<key_type, value_type>> live_pairs;
+	live_pairs.reserve(used_size - tombstones);
+	for(size_type i = 0; i < s->size; ++i){
+		const cell& c = s->slots[i];
+		if(c.state.load(std::memory_order_relaxed) == live){
+			live_pairs.emplace_back(c.key.load(std::memory_order_relaxed), c.value.load(std::memory_order_relaxed));
+		}
+	}
+	
+	begin_write();	//Readers racing the rehash see the sequence move and retry.
+	for(size_type i = 0; i < s->size; ++i){
+		s->slots[i].state.store(empty, std::memory_order_relaxed);
+	}
+	for(auto i = live_pairs.begin(); i != live_pairs.end(); ++i){
+		place(*s, i->first, i->second);
+	}
+	end_write();
+	used_size = size_type(live_pairs.size());
+	tombstones = 0;
+}
+
+template <class K, class V, class Hash, class Compare, class Sizing>
+void seqlock_hash_table<K, V, Hash, Compare, Sizing>::place(storage& s, const key_type& key, const value_type& value){	//Puts a key known to be absent in the first empty cell of its probe.
+	size_type index = Sizing::home(hasher()(key), s.size);
+	for(size_type i = 0; i < s.size; ++i){
+		cell& c = s.slots[Sizing::wrap(index + i, s.size)];
+		if(c.state.load(std::memory_order_relaxed) == empty){
+			c.key.store(key, std::memory_order_relaxed);
+			c.value.store(value, std::memory_order_relaxed);
+			c.state.store(live, std::memory_order_relaxed);
+			return;
+		}
+	}
+}
+
+}
+
+#endif
\ No newline at end of file
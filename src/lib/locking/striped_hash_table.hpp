@@ -0,0 +1,124 @@
+#ifndef LOCKING_STRIPED_HASH_TABLE_H_INCLUDED
+#define LOCKING_STRIPED_HASH_TABLE_H_INCLUDED
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include "hash_table.hpp"
+
+namespace locking{
+
+/*
+ * A thread-safe locking hash table split into independently locked stripes.
+ *
+ * Keys are spread over the stripes by their (mixed) hash, and each stripe
+ * is a whole hash_table with its own lock, so it also resizes on its own.
+ * Operations on keys in different stripes never touch the same lock.
+ * Stripes are hash_tables unless another table type is given (e.g. a
+ * seqlock_hash_table, for per-stripe sequence counters).
+ *
+ * for_each visits one stripe at a time, so it only ever blocks one
+ * stripe's writers.  parallel_for_each hands whole stripes out to its
+ * threads.  Both need the stripes' Table to have a for_each.
+ */
+template <class K, class V, class Hash = std::hash<K>, class Compare = std::equal_to<K>, class Table = hash_table<K, V, Hash, Compare>>
+class striped_hash_table{
+public:
+	
+	//Public Types
+	using size_type = int;
+	using key_type = K;
+	using value_type = V;
+	using hasher = Hash;
+	using comparer = Compare;
+	
+	//Constructors/Destructor
+	striped_hash_table(size_type s = 1, size_type n = default_stripes);
+	striped_hash_table(const striped_hash_table&) = delete;	//Same as hash_table.
+	striped_hash_table(striped_hash_table&&) = delete;
+	~striped_hash_table() = default;
+	
+	//Assignment Operators
+	striped_hash_table& operator=(const striped_hash_table&) = delete;
+	striped_hash_table& operator=(striped_hash_table&&) = delete;
+	
+	//Member Functions
+	bool get(const key_type& key, value_type& ret_value) const {return stripe_of(key).get(key, ret_value);}
+	void set(const key_type& key, const value_type& value) {stripe_of(key).set(key, value);}
+	void remove(const key_type& key) {stripe_of(key).remove(key);}
+	template <class F> void for_each(F&& f) const;
+	template <class F> void parallel_for_each(size_type n_threads, F&& f) const;
+	
+	//Static Data Members
+	static constexpr size_type default_stripes = 64;
+	
+private:
+	
+	//Private Types
+	struct alignas(64) stripe{	//Aligned so that neighbouring stripes' locks don't share a cache line.
+		stripe(size_type s) : table(s) {}
+		
+		Table table;
+	};
+	
+	//Data Members
+	std::vector<std::unique_ptr<stripe>> stripes;
+	
+	//Private Member Functions
+	Table& stripe_of(const key_type& key) const;
+	
+};
+
+template <class K, class V, class Hash, class Compare, class Table>
+striped_hash_table<K, V, Hash, Compare, Table>::striped_hash_table(size_type s, size_type n) : stripes(){
+	if(n < 1){
+		n = 1;
+	}
+	stripes.reserve(n);
+	for(size_type i = 0; i < n; ++i){
+		stripes.push_back(std::make_unique<stripe>((s + n - 1) / n));
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Table>
+template <class F>
+void striped_hash_table<K, V, Hash, Compare, Table>::for_each(F&& f) const{	//f is given each key and value.
+	for(auto i = stripes.begin(); i != stripes.end(); ++i){
+		(*i)->table.for_each(f);
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Table>
+template <class F>
+void striped_hash_table<K, V, Hash, Compare, Table>::parallel_for_each(size_type n_threads, F&& f) const{	//f is called from several threads at once, and mustn't throw.
+	if(n_threads < 1){
+		n_threads = 1;
+	}
+	auto visit_stripes = [this, n_threads, &f](size_type worker){
+		for(size_type i = worker; i < size_type(stripes.size()); i += n_threads){
+			stripes[i]->table.for_each(f);
+		}
+	};
+	std::vector<std::thread> workers;
+	workers.reserve(n_threads - 1);
+	for(size_type i = 1; i < n_threads; ++i){
+		workers.emplace_back(visit_stripes, i);
+	}
+	visit_stripes(0);
+	for(auto i = workers.begin(); i != workers.end(); ++i){
+		i->join();
+	}
+}
+
+template <class K, class V, class Hash, class Compare, class Table>
+Table& striped_hash_table<K, V, Hash, Compare, Table>::stripe_of(const key_type& key) const{
+	//The stripes' own probing uses the low bits of the hash, so pick the stripe from the high bits of a multiplicative mix.
+	std::uint64_t mixed = std::uint64_t(hasher()(key)) * 0x9E3779B97F4A7C15ull;
+	return stripes[(mixed >> 32) % stripes.size()]->table;
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include "lib/locking/hash_table.hpp"
+#include "lib/lockfree/hash_table.hpp"
+#include "lib/lockfree/double_ref_counter.hpp"
+#include "bench_harness.hpp"
+
+using locking_table = locking::hash_table<std::int32_t, std::int32_t>;
+using lockfree_table = lockfree::hash_table<std::int32_t, std::int32_t>;
+
+constexpr std::int32_t lookup_table_size = 1 << 16;
+
+std::int32_t scattered_key(std::uint32_t i){	//Murmur3's 32-bit finalizer, a bijection, so that keys land all over the table like real ones rather than in one run of cells.
+	i ^= i >> 16;
+	i *= 0x85ebca6bu;
+	i ^= i >> 13;
+	i *= 0xc2b2ae35u;
+	i ^= i >> 16;
+	return std::int32_t(i);
+}
+
+std::vector<int> thread_counts(int max_threads){	//1, 2, 4, ... and max_threads itself.
+	std::vector<int> counts;
+	for(int n = 1; n < max_threads; n *= 2){
+		counts.push_back(n);
+	}
+	counts.push_back(std::max(max_threads, 1));
+	return counts;
+}
+
+void add_ref_counter_benchmarks(bench_runner& runner, int max_threads){
+	for(int threads : thread_counts(max_threads)){
+		auto counter = std::make_shared<lockfree::double_ref_counter<std::int64_t>>(std::int64_t(0));
+		runner.add({"double_ref_counter/obtain/threads:" + std::to_string(threads), threads, {}, [counter](bench_state& state){
+			for(std::uint64_t i = 0; i < state.iterations(); ++i){
+				auto handle = counter->obtain();
+				do_not_optimize(*handle);
+			}
+		}, {}});
+		runner.add({"double_ref_counter/try_replace/threads:" + std::to_string(threads), threads, {}, [counter](bench_state& state){
+			for(std::uint64_t i = 0; i < state.iterations(); ++i){
+				auto handle = counter->obtain();
+				do_not_optimize(counter->try_replace(handle, std::int64_t(i)));
+			}
+		}, {}});
+	}
+}
+
+void add_insert_benchmarks(bench_runner& runner, int max_threads){	//Each insert goes through the table's insert counters, with no migrations to muddy them.
+	for(int threads : thread_counts(max_threads)){
+		auto table = std::make_shared<std::unique_ptr<lockfree_table>>();
+		runner.add({"lockfree::hash_table/insert/threads:" + std::to_string(threads), threads, [table](std::uint64_t iterations, int n){
+			*table = std::make_unique<lockfree_table>(lockfree_table::size_type(std::ceil(double(iterations) * n / 0.7)) + 1);
+		}, [table](bench_state& state){
+			std::int32_t first = std::int32_t(std::uint64_t(state.thread()) * state.iterations());
+			for(std::uint64_t i = 0; i < state.iterations(); ++i){
+				(*table)->set(first + std::int32_t(i), 0);
+			}
+		}, [table](){
+			table->reset();
+		}, std::uint64_t(double(std::numeric_limits<std::int32_t>::max()) * 0.6) / std::uint64_t(threads)});	//Every thread's keys, and the table sized for all of them, stay within int32.
+	}
+}
+
+template <class Table>
+void add_lookup_benchmarks(bench_runner& runner, const std::string& table_name){
+	const double loads[] = {0.1, 0.3, 0.5, 0.69};	//Both tables grow once they're 70% full.
+	for(double load : loads){
+		std::int32_t count = std::int32_t(load * lookup_table_size);
+		auto table = std::make_shared<std::unique_ptr<Table>>();
+		auto fill = [table, count](std::uint64_t, int){	//Built once, and only read from after that.
+			if(!*table){
+				*table = std::make_unique<Table>(lookup_table_size);
+				for(std::int32_t k = 0; k < count; ++k){
+					(*table)->set(scattered_key(std::uint32_t(k)), k);
+				}
+			}
+		};
+		std::string suffix = "/load:" + std::to_string(load).substr(0, 4);
+		runner.add({table_name + "/get_hit" + suffix, 1, fill, [table, count](bench_state& state){
+			std::int32_t value;
+			for(std::uint64_t i = 0; i < state.iterations(); ++i){
+				std::int32_t key = scattered_key(std::uint32_t(i % std::uint64_t(count)));
+				do_not_optimize((*table)->get(key, value));
+			}
+		}, {}});
+		runner.add({table_name + "/get_miss" + suffix, 1, fill, [table, count](bench_state& state){
+			std::int32_t value;
+			for(std::uint64_t i = 0; i < state.iterations(); ++i){
+				std::int32_t key = scattered_key(std::uint32_t(count + i % (1u << 30)));	//Never one of the inserted keys.
+				do_not_optimize((*table)->get(key, value));
+			}
+		}, {}});
+	}
+}
+
+void add_resize_benchmarks(bench_runner& runner){	//Times the insert that takes a full table over its capacity.
+	const std::int32_t sizes[] = {1 << 10, 1 << 14, 1 << 17};
+	for(std::int32_t size : sizes){
+		runner.add({"locking::hash_table/resize/size:" + std::to_string(size), 1, {}, [size](bench_state& state){
+			std::int32_t capacity = std::int32_t(std::ceil(size * 0.7f));	//As the table works it out.
+			for(std::uint64_t i = 0; i < state.iterations(); ++i){
+				state.pause();
+				auto table = std::make_unique<locking_table>(size);
+				for(std::int32_t k = 0; k < capacity; ++k){
+					table->set(k, k);
+				}
+				state.resume();
+				table->set(capacity, capacity);
+				state.pause();
+				table.reset();
+				state.resume();
+			}
+		}, {}});
+	}
+}
+
+int main(int argc, char* argv[]){
+	bench_options options;
+	bool json = false;
+	int max_threads = std::max(1, int(std::thread::hardware_concurrency()));
+	for(int i = 1; i < argc; ++i){
+		std::string arg = argv[i];
+		std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+		if(arg == "--json"){
+			json = true;
+		}else if(arg == "--no_pin"){
+			options.pin = false;
+		}else if(arg.rfind("--filter=", 0) == 0){
+			options.filter = value;
+		}else if(arg.rfind("--repetitions=", 0) == 0){
+			options.repetitions = std::max(1, std::atoi(value.c_str()));
+		}else if(arg.rfind("--warmup=", 0) == 0){
+			options.warmup = std::max(0, std::atoi(value.c_str()));
+		}else if(arg.rfind("--min_time=", 0) == 0){
+			options.min_time = std::atof(value.c_str());
+		}else if(arg.rfind("--threads=", 0) == 0){
+			max_threads = std::max(1, std::atoi(value.c_str()));
+		}else{
+			std::cerr << "Unknown argument: " << arg << "\n\tTry: " << argv[0] << " [--json] [--filter=substring] [--repetitions=5] [--warmup=1] [--min_time=0.1] [--threads=" << max_threads << "] [--no_pin]\n";
+			return -1;
+		}
+	}
+	
+	bench_runner runner(options);
+	add_ref_counter_benchmarks(runner, max_threads);
+	add_insert_benchmarks(runner, max_threads);
+	add_lookup_benchmarks<locking_table>(runner, "locking::hash_table");
+	add_lookup_benchmarks<lockfree_table>(runner, "lockfree::hash_table");
+	add_resize_benchmarks(runner);
+	
+	std::vector<bench_result> results = runner.run(std::cerr);	//Progress goes to stderr, so that stdout only has the results.
+	if(json){
+		runner.print_json(std::cout, results);
+	}else{
+		bench_runner::print_console(std::cout, results);
+	}
+	
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+#ifndef BENCH_HARNESS_H_INCLUDED
+#define BENCH_HARNESS_H_INCLUDED
+
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <sched.h>
+#include <pthread.h>
+
+/*
+ * A small microbenchmark harness (in the spirit of google-benchmark).
+ *
+ * A benchmark runs its body on some number of threads, each doing the same
+ * number of iterations.  The harness picks that number by growing it until
+ * a run takes at least min_time, runs it warmup times untimed, then times
+ * it repetitions times.  Threads are pinned to CPUs, and start together
+ * once they're all ready.  Bodies can pause their own clock around work
+ * that isn't part of the measurement.
+ *
+ * Results are per operation (a thread's time over its iterations), and
+ * can be printed for people or as JSON for comparing versions.
+ */
+using bench_clock = std::chrono::steady_clock;
+
+template <class T>
+inline void do_not_optimize(const T& value){	//Makes the compiler assume value is used.
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class bench_state{
+public:
+	
+	//Constructors/Destructor
+	bench_state(int t, int n, std::uint64_t i) : thread_index(t), thread_count(n), iteration_count(i), elapsed(0), started(), paused(true) {}
+	
+	//Member Functions
+	int thread() const {return thread_index;}
+	int threads() const {return thread_count;}
+	std::uint64_t iterations() const {return iteration_count;}
+	void pause();
+	void resume();
+	double seconds() const {return std::chrono::duration<double>(elapsed).count();}
+	
+private:
+	
+	//Data Members
+	int thread_index;
+	int thread_count;
+	std::uint64_t iteration_count;
+	bench_clock::duration elapsed;
+	bench_clock::time_point started;
+	bool paused;
+	
+};
+
+inline void bench_state::pause(){
+	if(!paused){
+		elapsed += bench_clock::now() - started;
+		paused = true;
+	}
+}
+
+inline void bench_state::resume(){
+	if(paused){
+		started = bench_clock::now();
+		paused = false;
+	}
+}
+
+struct benchmark{
+	std::string name;
+	int threads;
+	std::function<void(std::uint64_t iterations, int threads)> setup;	//Runs before each run, untimed (may be empty).
+	std::function<void(bench_state&)> body;
+	std::function<void()> teardown;	//Runs after each run, untimed (may be empty).
+	std::uint64_t max_iterations = std::uint64_t(1) << 40;	//Per thread, for bodies whose keys or tables only hold so many.
+};
+
+struct bench_options{
+	int warmup = 1;
+	int repetitions = 5;
+	double min_time = 0.1;	//Seconds per timed run.
+	bool pin = true;
+	std::string filter;	//Only benchmarks with this in their names are run.
+};
+
+struct bench_result{
+	std::string name;
+	int threads;
+	std::uint64_t iterations;
+	std::vector<double> ns_per_op;	//One per repetition.
+	double mean;
+	double median;
+	double stddev;
+	double min;
+};
+
+class bench_runner{
+public:
+	
+	//Constructors/Destructor
+	explicit bench_runner(const bench_options& o);
+	
+	//Member Functions
+	void add(benchmark b) {benchmarks.push_back(std::move(b));}
+	std::vector<bench_result> run(std::ostream& progress);
+	static void print_console(std::ostream& out, const std::vector<bench_result>& results);
+	void print_json(std::ostream& out, const std::vector<bench_result>& results) const;
+	
+private:
+	
+	//Data Members
+	bench_options opts;
+	std::vector<int> cpus;	//The CPUs this process may run on, which threads are pinned to in turn.
+	std::vector<benchmark> benchmarks;
+	
+	//Private Member Functions
+	double run_once(const benchmark& b, std::uint64_t iterations);
+	
+};
+
+inline bench_runner::bench_runner(const bench_options& o) : opts(o), cpus(), benchmarks(){
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0){
+		for(int c = 0; c < CPU_SETSIZE; ++c){
+			if(CPU_ISSET(c, &allowed)){
+				cpus.push_back(c);
+			}
+		}
+	}
+}
+
+inline std::vector<bench_result> bench_runner::run(std::ostream& progress){
+	std::vector<bench_result> results;
+	for(const benchmark& b : benchmarks){
+		if(b.name.find(opts.filter) == std::string::npos){
+			continue;
+		}
+		progress << "Running " << b.name << "..." << std::endl;
+		
+		std::uint64_t iterations = 1;
+		for(double seconds = run_once(b, iterations); seconds < opts.min_time && iterations < b.max_iterations; seconds = run_once(b, iterations)){	//Grows the iterations until a run is long enough.
+			double factor = seconds > 0 ? opts.min_time / seconds * 1.4 : 10.0;
+			iterations = std::min(b.max_iterations, std::uint64_t(double(iterations) * std::min(10.0, std::max(2.0, factor))));
+		}
+		for(int w = 0; w < opts.warmup; ++w){
+			run_once(b, iterations);
+		}
+		
+		bench_result result{b.name, b.threads, iterations, {}, 0, 0, 0, 0};
+		for(int r = 0; r < std::max(opts.repetitions, 1); ++r){
+			result.ns_per_op.push_back(run_once(b, iterations) * 1e9 / double(iterations));
+		}
+		std::vector<double> sorted = result.ns_per_op;
+		std::sort(sorted.begin(), sorted.end());
+		for(double x : sorted){
+			result.mean += x / double(sorted.size());
+		}
+		for(double x : sorted){
+			result.stddev += (x - result.mean) * (x - result.mean) / double(sorted.size());
+		}
+		result.stddev = std::sqrt(result.stddev);
+		result.median = sorted.size() % 2 != 0 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2.0;
+		result.min = sorted.front();
+		results.push_back(result);
+	}
+	return results;
+}
+
+inline double bench_runner::run_once(const benchmark& b, std::uint64_t iterations){	//Returns the slowest thread's time.
+	if(b.setup){
+		b.setup(iterations, b.threads);
+	}
+	
+	std::mutex mu;
+	std::condition_variable cv;
+	int ready = 0;
+	bool go = false;
+	std::vector<double> seconds(b.threads);
+	std::vector<std::thread> workers;
+	for(int t = 0; t < b.threads; ++t){
+		workers.emplace_back([&, t](){
+			if(opts.pin && !cpus.empty()){
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(cpus[std::size_t(t) % cpus.size()], &set);
+				pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+			}
+			bench_state state(t, b.threads, iterations);
+			{
+				std::unique_lock lk(mu);
+				++ready;
+				cv.notify_all();
+				cv.wait(lk, [&](){return go;});
+			}
+			state.resume();
+			b.body(state);
+			state.pause();
+			seconds[t] = state.seconds();
+		});
+	}
+	{
+		std::unique_lock lk(mu);
+		cv.wait(lk, [&](){return ready == b.threads;});
+		go = true;
+	}
+	cv.notify_all();
+	for(auto i = workers.begin(); i != workers.end(); ++i){
+		i->join();
+	}
+	
+	if(b.teardown){
+		b.teardown();
+	}
+	return *std::max_element(seconds.begin(), seconds.end());
+}
+
+inline void bench_runner::print_console(std::ostream& out, const std::vector<bench_result>& results){
+	out << std::left << std::setw(52) << "Benchmark" << std::right << std::setw(14) << "Iterations" << std::setw(14) << "Mean ns/op" << std::setw(14) << "Median" << std::setw(12) << "Stddev" << "\n";
+	for(const bench_result& r : results){
+		out << std::left << std::setw(52) << r.name << std::right << std::setw(14) << r.iterations << std::fixed << std::setprecision(2) << std::setw(14) << r.mean << std::setw(14) << r.median << std::setw(12) << r.stddev << std::defaultfloat << "\n";
+	}
+}
+
+inline void bench_runner::print_json(std::ostream& out, const std::vector<bench_result>& results) const{	//Names never need escaping, since the suite makes them.
+	out << "{\n";
+	out << "  \"context\": {\"cpus\": " << cpus.size() << ", \"pinned\": " << (opts.pin ? "true" : "false") << ", \"warmup\": " << opts.warmup << ", \"repetitions\": " << opts.repetitions << ", \"min_time\": " << opts.min_time << "},\n";
+	out << "  \"benchmarks\": [";
+	for(std::size_t i = 0; i < results.size(); ++i){
+		const bench_result& r = results[i];
+		out << (i == 0 ? "\n" : ",\n");
+		out << "    {\"name\": \"" << r.name << "\", \"threads\": " << r.threads << ", \"iterations\": " << r.iterations;
+		out << ", \"mean_ns\": " << r.mean << ", \"median_ns\": " << r.median << ", \"stddev_ns\": " << r.stddev << ", \"min_ns\": " << r.min;
+		out << ", \"ops_per_sec\": " << (r.mean > 0 ? 1e9 / r.mean * r.threads : 0.0) << ", \"samples_ns\": [";
+		for(std::size_t j = 0; j < r.ns_per_op.size(); ++j){
+			out << (j == 0 ? "" : ", ") << r.ns_per_op[j];
+		}
+		out << "]}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+#endif
\ No newline at end of file
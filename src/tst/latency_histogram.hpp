@@ -0,0 +1,101 @@
+#ifndef LATENCY_HISTOGRAM_H_INCLUDED
+#define LATENCY_HISTOGRAM_H_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+/*
+ * A fixed-size log-linear histogram of latencies (as in HdrHistogram).
+ *
+ * Values below 128 get a bucket each, and every power of two above that is
+ * split into 64 buckets, so a recorded value is off by less than 1/64
+ * (about 1.6%) from the one reported for it.  Recording is a few shifts and
+ * an increment, and each thread can keep its own histogram and merge it in
+ * at the end, rather than storing every sample.
+ */
+class latency_histogram{
+public:
+	
+	//Constructors/Destructor
+	latency_histogram() : counts(), total(0), sum(0), max_value(0) {}
+	
+	//Member Functions
+	void record(std::uint64_t value);
+	void merge(const latency_histogram& other);
+	std::uint64_t count() const {return total;}
+	double mean() const {return total != 0 ? double(sum) / double(total) : 0.0;}
+	std::uint64_t max() const {return max_value;}
+	std::uint64_t percentile(double p) const;	//The smallest value at least p percent of the samples are at or below (to within a bucket).
+	
+private:
+	
+	//Static Data Members
+	static constexpr int sub_bucket_bits = 7;
+	static constexpr std::uint64_t sub_buckets = std::uint64_t(1) << sub_bucket_bits;
+	static constexpr std::size_t bucket_count = sub_buckets + (64 - sub_bucket_bits) * (sub_buckets / 2);
+	
+	//Data Members
+	std::array<std::uint64_t, bucket_count> counts;
+	std::uint64_t total;
+	std::uint64_t sum;
+	std::uint64_t max_value;
+	
+	//Private Member Functions
+	static std::size_t bucket_of(std::uint64_t value);
+	static std::uint64_t highest_in(std::size_t bucket);
+	
+};
+
+inline void latency_histogram::record(std::uint64_t value){
+	++counts[bucket_of(value)];
+	++total;
+	sum += value;
+	max_value = std::max(max_value, value);
+}
+
+inline void latency_histogram::merge(const latency_histogram& other){
+	for(std::size_t i = 0; i < bucket_count; ++i){
+		counts[i] += other.counts[i];
+	}
+	total += other.total;
+	sum += other.sum;
+	max_value = std::max(max_value, other.max_value);
+}
+
+inline std::uint64_t latency_histogram::percentile(double p) const{
+	if(total == 0){
+		return 0;
+	}
+	std::uint64_t rank = std::max<std::uint64_t>(1, std::uint64_t(double(total) * p / 100.0 + 0.5));
+	std::uint64_t seen = 0;
+	for(std::size_t i = 0; i < bucket_count; ++i){
+		seen += counts[i];
+		if(seen >= rank){
+			return std::min(highest_in(i), max_value);
+		}
+	}
+	return max_value;
+}
+
+inline std::size_t latency_histogram::bucket_of(std::uint64_t value){
+	if(value < sub_buckets){
+		return std::size_t(value);
+	}
+	int magnitude = 63 - __builtin_clzll(value);	//At least sub_bucket_bits.
+	std::uint64_t top = value >> (magnitude - sub_bucket_bits + 1);	//The value's top sub_bucket_bits bits, in [sub_buckets / 2, sub_buckets).
+	return std::size_t(sub_buckets + std::uint64_t(magnitude - sub_bucket_bits) * (sub_buckets / 2) + (top - sub_buckets / 2));
+}
+
+inline std::uint64_t latency_histogram::highest_in(std::size_t bucket){
+	if(bucket < sub_buckets){
+		return std::uint64_t(bucket);
+	}
+	std::uint64_t offset = std::uint64_t(bucket) - sub_buckets;
+	int shift = int(offset / (sub_buckets / 2)) + 1;
+	std::uint64_t top = sub_buckets / 2 + offset % (sub_buckets / 2);
+	return ((top + 1) << shift) - 1;
+}
+
+#endif
\ No newline at end of file
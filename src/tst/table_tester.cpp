@@ -1,12 +1,25 @@
+#include <map>
 #include <mutex>
+#include <atomic>
 #include <thread>
 #include <vector>
 #include <string>
+#include <cstdio>
 #include <cstdlib>
+#include <utility>
+#include <fstream>
 #include <iostream>
+#include <exception>
+#include <filesystem>
 #include <functional>
+#include <system_error>
+#include <condition_variable>
+#include <unistd.h>
 #include "lib/locking/hash_table.hpp"
+#include "lib/locking/robin_hood_hash_table.hpp"
 #include "lib/lockfree/hash_table.hpp"
+#include "lib/lockfree/flat_hash_table.hpp"
+#include "lib/hashing/journaled_hash_table.hpp"
 
 std::mutex out_mu;
 
@@ -138,11 +151,381 @@ void test_scenario(int gtrs, int strs, int rmrs){
 	}
 }
 
+/*
+ * Checks of the tables' behaviour, each of which returns whether it passed.
+ * Unlike the scenario above, these know what the tables should hold at the
+ * end, and several are aimed at a specific race or policy.
+ */
+struct gate{	//Holds a thread at a chosen point until the test lets it go.
+	std::mutex mu;
+	std::condition_variable cv;
+	bool reached = false;
+	bool opened = false;
+	
+	void arrive() {std::unique_lock lk(mu); reached = true; cv.notify_all(); cv.wait(lk, [&](){return opened;});}
+	void wait_reached() {std::unique_lock lk(mu); cv.wait(lk, [&](){return reached;});}
+	void open() {std::unique_lock lk(mu); opened = true; cv.notify_all();}
+};
+
+thread_local gate* armed_gate = nullptr;
+thread_local int calls_before_gate = 0;
+
+void gate_checkpoint(){	//Stops at the armed gate once the thread has hashed or compared calls_before_gate more times.
+	if(armed_gate != nullptr && calls_before_gate-- == 0){
+		gate* g = armed_gate;
+		armed_gate = nullptr;
+		g->arrive();
+	}
+}
+
+struct gated_hash{	//Every key collides, so that every probe compares keys.
+	std::size_t operator()(int) const {gate_checkpoint(); return 0;}
+};
+
+struct gated_compare{
+	bool operator()(int a, int b) const {gate_checkpoint(); return a == b;}
+};
+
+template <class Table>
+bool check_counters(){	//Concurrent fetch_adds lose no increments, while other keys are set and removed (and tables are migrated and reclaimed) around them.
+	Table table(1);
+	const int writers = 4, ops = 10000, counters = 64;
+	std::vector<std::thread> workers;
+	for(int w = 0; w < writers; ++w){
+		workers.push_back(std::thread([&table, w](){
+			for(int i = 0; i < ops; ++i){
+				table.fetch_add(i % counters, 1);
+				table.set(counters + w * ops + i, i);
+				if(i % 2 != 0){
+					table.remove(counters + w * ops + i - 1);
+				}
+			}
+		}));
+	}
+	for(auto i = workers.begin(); i != workers.end(); ++i){
+		i->join();
+	}
+	
+	int total = 0, value;
+	for(int k = 0; k < counters; ++k){
+		total += table.get(k, value) ? value : 0;
+	}
+	for(int k = counters; k < counters + writers * ops; ++k){
+		int i = (k - counters) % ops;
+		if(table.get(k, value) != (i % 2 != 0) || (i % 2 != 0 && value != i)){	//Only the odd ones are left.
+			return false;
+		}
+	}
+	return total == writers * ops;
+}
+
+template <class Table>
+bool check_churn(){	//Keys are set and removed over and over, so that tables fill with tombstones and are compacted (or grown) many times.
+	Table table(1);
+	const int keys = 200, rounds = 50;
+	for(int r = 0; r < rounds; ++r){
+		for(int k = 0; k < keys; ++k){
+			table.set(k, r * 1000 + k);
+		}
+		for(int k = 0; k < keys; ++k){
+			if((k + r) % 2 == 0){
+				table.remove(k);
+			}
+		}
+	}
+	
+	int value;
+	for(int k = 0; k < keys; ++k){
+		bool kept = (k + rounds - 1) % 2 != 0;
+		if(table.get(k, value) != kept || (kept && value != (rounds - 1) * 1000 + k)){
+			return false;
+		}
+	}
+	return true;
+}
+
+template <class Table>
+bool check_read_modify_write(){	//The update, compute_if_absent, compare_and_set and fetch_add results a single thread should see.
+	Table table(1);
+	int value;
+	bool ok = !table.update(0, [](int& v){v += 1;});
+	ok = ok && table.compute_if_absent(0, [](){return 5;}) && !table.compute_if_absent(0, [](){return 6;});
+	ok = ok && table.update(0, [](int& v){v *= 2;}) && table.get(0, value) && value == 10;
+	ok = ok && !table.compare_and_set(0, 11, 12) && table.compare_and_set(0, 10, 12);
+	ok = ok && table.fetch_add(0, 3) == 12 && table.fetch_add(1, 4) == 0;
+	return ok && table.get(0, value) && value == 15 && table.get(1, value) && value == 4;
+}
+
+bool check_update_during_migration(){	//An update which found a key in an older table, and is held there while the table is migrated and reclaimed, must still see its value.
+	using Table = lockfree::hash_table<int, int, gated_hash, gated_compare, lockfree::hazard_reclaimed<>>;
+	Table table(1);
+	table.set(0, 100);
+	table.set(1, 1);
+	gate migrator_gate, modifier_gate;
+	std::thread migrator([&table, &migrator_gate](){	//Appends a table, and stops partway through migrating into it.
+		armed_gate = &migrator_gate;
+		calls_before_gate = 1;
+		table.set(2, 2);
+		Table scratch(1);
+		for(int i = 0; i < 200; ++i){	//Retires enough to make the hazard domain scan, freeing whatever isn't protected.
+			scratch.set(0, i);
+		}
+	});
+	migrator_gate.wait_reached();
+	table.set(3, 3);
+	table.set(4, 4);
+	bool updated = false;
+	std::thread modifier([&table, &modifier_gate, &updated](){	//Stops once it has found key 0 in the older table.
+		armed_gate = &modifier_gate;
+		calls_before_gate = 2;
+		updated = table.update(0, [](int& v){v += 1;});
+	});
+	modifier_gate.wait_reached();
+	migrator_gate.open();
+	migrator.join();
+	modifier_gate.open();
+	modifier.join();
+	
+	int value;
+	return updated && table.get(0, value) && value == 101;
+}
+
+template <class Table>
+bool check_for_each(){	//for_each and parallel_for_each each see every key once, in a table grown from one cell.
+	Table table(1);
+	const int keys = 10000;
+	long long expected = 0;
+	for(int k = 0; k < keys; ++k){
+		table.set(k, 2 * k);
+	}
+	for(int k = 0; k < keys; k += 10){
+		table.remove(k);
+	}
+	for(int k = 0; k < keys; ++k){
+		expected += k % 10 != 0 ? 2 * k : 0;
+	}
+	
+	long long sum = 0;
+	int count = 0;
+	table.for_each([&](const int&, const int& v){sum += v; ++count;});
+	std::atomic<long long> parallel_sum(0);
+	std::atomic<int> parallel_count(0);
+	table.parallel_for_each(4, [&](const int&, const int& v){parallel_sum += v; ++parallel_count;});
+	return sum == expected && count == keys - keys / 10 && parallel_sum == expected && parallel_count == count;
+}
+
+bool iterate_keys(const lockfree::hash_table<int, int>& table, int keys, bool exactly_once){	//Whether an iteration saw each of keys [0, keys) with its own value.
+	std::vector<int> seen(keys, 0);
+	bool ok = true;
+	for(auto i = table.begin(); i != table.end(); ++i){
+		auto pair = *i;
+		if(pair.first < keys){
+			ok = ok && pair.second == pair.first;
+			++seen[pair.first];
+		}
+	}
+	for(int times : seen){
+		ok = ok && (exactly_once ? times == 1 : times >= 1);
+	}
+	return ok;
+}
+
+bool check_iterators(){	//Iterators see every key once, and while another thread keeps migrating the table, at least once (a key being migrated may be seen in both tables).
+	lockfree::hash_table<int, int> table(1);
+	const int keys = 10000;
+	for(int k = 0; k < keys; ++k){
+		table.set(k, k);
+	}
+	bool ok = iterate_keys(table, keys, true);
+	std::atomic<bool> stop(false);
+	std::thread writer([&table, &stop](){	//Only sets keys the iterations ignore.
+		for(int k = keys; !stop.load(); ++k){
+			table.set(k, k);
+		}
+	});
+	for(int pass = 0; pass < 10; ++pass){
+		ok = ok && iterate_keys(table, keys, false);
+	}
+	stop.store(true);
+	writer.join();
+	return ok;
+}
+
+template <class Table>
+bool check_bulk_build(){	//A table built from a range holds the same as one set key by key, with later duplicates winning.
+	std::vector<std::pair<int, int>> pairs;
+	for(int i = 0; i < 100000; ++i){
+		pairs.push_back({i % 70000, i});
+	}
+	Table built(pairs.begin(), pairs.end(), 4);
+	
+	int value;
+	for(int k = 0; k < 70000; ++k){
+		if(!built.get(k, value) || value != (k < 30000 ? k + 70000 : k)){
+			return false;
+		}
+	}
+	return !built.get(70000, value);
+}
+
+std::string scratch_path(const std::string& name){	//A file of this process's own, so that several testers can run at once.
+	return (std::filesystem::temp_directory_path() / ("table_tester." + std::to_string(::getpid()) + "." + name)).string();
+}
+
+bool check_snapshot(){	//A saved table maps back in with the same contents, and a file that isn't a snapshot is refused.
+	std::string path = scratch_path("snapshot");
+	locking::hash_table<int, int> table(4);
+	for(int k = 0; k < 1000; ++k){
+		table.set(k, 3 * k);
+	}
+	table.remove(500);
+	table.save(path);
+	
+	bool ok = true;
+	{
+		locking::hash_table<int, int> mapped = locking::hash_table<int, int>::open_mapped(path);
+		int value;
+		for(int k = 0; k < 1000; ++k){
+			ok = ok && mapped.get(k, value) == (k != 500) && (k == 500 || value == 3 * k);
+		}
+	}
+	std::ofstream(path, std::ios::trunc).close();
+	try{
+		locking::hash_table<int, int>::open_mapped(path);
+		ok = false;
+	}catch(const std::system_error&){
+	}
+	std::remove(path.c_str());
+	return ok;
+}
+
+template <class Table>
+bool check_journal_replay(){	//Replaying a synced journal rebuilds what the table held, although four threads wrote it at once.
+	using journaled = hashing::journaled_hash_table<Table>;
+	std::string path = scratch_path("journal");
+	std::remove(path.c_str());
+	std::map<int, int> expected;
+	{
+		journaled table(path, 1);
+		std::vector<std::thread> workers;
+		for(int w = 0; w < 4; ++w){
+			workers.push_back(std::thread([&table, w](){
+				for(int i = 0; i < 20000; ++i){
+					table.set(i % 1000, 4 * i + w);
+					if(i % 7 == 0){
+						table.remove((i + 3) % 1000);
+					}
+				}
+			}));
+		}
+		for(auto i = workers.begin(); i != workers.end(); ++i){
+			i->join();
+		}
+		table.sync();
+		table.for_each([&](const int& k, const int& v){expected[k] = v;});
+	}
+	
+	Table replayed(1);
+	bool ok = journaled::replay(path, replayed) > 0;
+	std::map<int, int> actual;
+	replayed.for_each([&](const int& k, const int& v){actual[k] = v;});
+	std::remove(path.c_str());
+	return ok && actual == expected;
+}
+
+template <class Table>
+bool check_shared_copies(){	//Copies of a reference counted table share its chain, so each sees what the others set, through growth and migration.
+	Table original(1);
+	original.set(0, 0);
+	Table copy(original);
+	Table assigned;
+	assigned = copy;
+	for(int k = 1; k < 1000; ++k){
+		(k % 2 == 0 ? copy : assigned).set(k, k);
+	}
+	
+	int value;
+	for(int k = 0; k < 1000; ++k){
+		if(!original.get(k, value) || value != k){
+			return false;
+		}
+	}
+	return true;
+}
+
+struct exiting_thread_nodes{	//Made before the thread's node pool cache, so destroyed after it.
+	void* kept = nullptr;
+	
+	~exiting_thread_nodes() {using pool = lockfree::node_pool<16>; pool::deallocate(pool::allocate()); pool::deallocate(kept);}
+};
+
+thread_local exiting_thread_nodes exiting_nodes;
+
+bool check_pool_thread_exit(){	//Nodes can still be allocated and freed while a thread exits, once its pool cache is gone (a failure crashes rather than returning false).
+	std::thread exiting([](){
+		exiting_thread_nodes& nodes = exiting_nodes;
+		nodes.kept = lockfree::node_pool<16>::allocate();
+	});
+	exiting.join();
+	return true;
+}
+
+int run_checks(){	//Returns how many checks failed.
+	using epoch_table = lockfree::hash_table<int, int>;
+	using hazard_table = lockfree::hash_table<int, int, std::hash<int>, std::equal_to<int>, lockfree::hazard_reclaimed<>>;
+	using ref_counted_table = lockfree::hash_table<int, int, std::hash<int>, std::equal_to<int>, lockfree::ref_counted<>>;
+	using pooled_table = lockfree::hash_table<int, int, std::hash<int>, std::equal_to<int>, lockfree::epoch_reclaimed<lockfree::default_epoch_domain, lockfree::pooled_allocator>>;
+	const std::vector<std::pair<const char*, std::function<bool()>>> checks = {
+		{"fetch_add counts (epochs)", check_counters<epoch_table>},
+		{"fetch_add counts (hazard pointers)", check_counters<hazard_table>},
+		{"fetch_add counts (reference counts)", check_counters<ref_counted_table>},
+		{"fetch_add counts (pooled nodes)", check_counters<pooled_table>},
+		{"fetch_add counts (locking)", check_counters<locking::hash_table<int, int>>},
+		{"Migration and compaction (lockfree)", check_churn<epoch_table>},
+		{"Migration and compaction (hazard pointers)", check_churn<hazard_table>},
+		{"Migration and compaction (flat lockfree)", check_churn<lockfree::flat_hash_table<int, int>>},
+		{"Tombstones and resizing (locking)", check_churn<locking::hash_table<int, int>>},
+		{"Tombstones and resizing (Robin Hood)", check_churn<locking::robin_hood_hash_table<int, int>>},
+		{"Read-modify-write (lockfree)", check_read_modify_write<epoch_table>},
+		{"Read-modify-write (locking)", check_read_modify_write<locking::hash_table<int, int>>},
+		{"Update during migration (hazard pointers)", check_update_during_migration},
+		{"for_each (lockfree)", check_for_each<epoch_table>},
+		{"for_each (locking)", check_for_each<locking::hash_table<int, int>>},
+		{"Iterators (lockfree)", check_iterators},
+		{"Bulk build (lockfree)", check_bulk_build<epoch_table>},
+		{"Bulk build (locking)", check_bulk_build<locking::hash_table<int, int>>},
+		{"Snapshot round-trip (locking)", check_snapshot},
+		{"Journal replay (lockfree)", check_journal_replay<epoch_table>},
+		{"Journal replay (locking)", check_journal_replay<locking::hash_table<int, int>>},
+		{"Pooled nodes freed during thread exit", check_pool_thread_exit},
+		{"Shared copies (reference counts)", check_shared_copies<ref_counted_table>},
+		{"Shared copies (flat, reference counts)", check_shared_copies<lockfree::flat_hash_table<int, int, std::hash<int>, std::equal_to<int>, lockfree::ref_counted<>>>}
+	};
+	
+	int failed = 0;
+	for(const auto& check : checks){
+		bool passed;
+		try{
+			passed = check.second();
+		}catch(const std::exception& e){
+			std::cout << "[" << check.first << "] Threw: " << e.what() << "\n";
+			passed = false;
+		}
+		std::cout << "[" << check.first << "] " << (passed ? "Passed" : "FAILED") << "\n";
+		failed += passed ? 0 : 1;
+	}
+	std::cout << "\n" << (checks.size() - failed) << " of " << checks.size() << " checks passed\n";
+	return failed;
+}
+
 int main(int argc, char* argv[]){
 	std::srand(std::time(0));
 	
+	if(argc > 1 && std::string(argv[1]) == "--check"){
+		return run_checks() == 0 ? 0 : 1;
+	}
 	if(argc < 5){
-		std::cerr << "Insufficient arguments:\n\tTry: " << argv[0] << " use_lockfree getters setters remover\n\tIf use_lockfree is 0 the locking hash table is used, otherwise the lockfree hash table is used.\n";
+		std::cerr << "Insufficient arguments:\n\tTry: " << argv[0] << " use_lockfree getters setters remover\n\tOr: " << argv[0] << " --check\n\tIf use_lockfree is 0 the locking hash table is used, otherwise the lockfree hash table is used.\n\tThe second form runs behaviour checks of the tables (reclamation, migration, read-modify-write, iteration, bulk building, snapshots and journals), and fails if any of them do.\n";
 		return -1;
 	}
 	
@@ -1,137 +1,517 @@
 #include <mutex>
-#include <cmath>
+#include <atomic>
+#include <string>
 #include <thread>
 #include <vector>
+#include <limits>
 #include <chrono>
+#include <algorithm>
 #include <cstdlib>
 #include <cstdint>
+#include <cctype>
+#include <utility>
 #include <iostream>
 #include <functional>
+#include <type_traits>
 #include "lib/locking/hash_table.hpp"
+#include "lib/locking/seqlock_hash_table.hpp"
+#include "lib/locking/robin_hood_hash_table.hpp"
+#include "lib/locking/striped_hash_table.hpp"
 #include "lib/lockfree/hash_table.hpp"
+#include "lib/lockfree/flat_hash_table.hpp"
+#include "latency_histogram.hpp"
+#include "workload.hpp"
 
 using testing_clock = std::chrono::steady_clock;
 
-std::mutex acc_vec_mu;
-std::mutex mut_vec_mu;
+constexpr std::size_t op_buffer_limit = 1 << 20;	//Operations generated per thread, which longer runs cycle through.
 
-std::vector<testing_clock::duration::rep> acc_vec;
-std::vector<testing_clock::duration::rep> mut_vec;
+const char* const op_names[op_types] = {"Read", "Update", "Insert", "Delete"};
 
-double avg_vector(std::vector<testing_clock::duration::rep>& vec){
-	testing_clock::duration::rep sum = 0;
-	for(auto i = vec.begin(); i != vec.end(); ++i){
-		sum += *i;
+struct scenario_result{
+	double seconds;	//From starting the threads to joining them.
+	std::uint64_t ops;
+	std::uint64_t elements;	//In the table at the end.
+	std::int64_t chain_length;	//Tables in the chain at the end, or -1 for tables that don't keep one.
+	std::vector<latency_histogram> hists;	//One per op_type, in nanoseconds.
+};
+
+template <class T>
+struct table_tag{
+	using type = T;
+};
+
+void print_latencies(const char* name, const latency_histogram& hist){
+	std::cout << name << " Samples: " << hist.count() << "\n";
+	std::cout << name << " Average: " << hist.mean() / 1000.0 << " microseconds\n";
+	const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+	for(double p : percentiles){
+		std::cout << name << " p" << p << ": " << double(hist.percentile(p)) / 1000.0 << " microseconds\n";
+	}
+	std::cout << name << " Max: " << double(hist.max()) / 1000.0 << " microseconds\n";
+}
+
+template <class Table, class = void>
+struct has_chain_length : std::false_type {};
+
+template <class Table>
+struct has_chain_length<Table, std::void_t<decltype(std::declval<const Table&>().chain_length())>> : std::true_type {};
+
+template <class K>
+bool keys_fit(const workload& load, const op_mix& mix, int n_threads, std::size_t count){	//Whether every key the workload can give is a K, since apply casts them, and isn't K's largest value, which the flat table reserves as its empty key.
+	return load.key_bound(mix, n_threads, count) - 1 < std::uint64_t(std::numeric_limits<K>::max());
+}
+
+template <class Table, class K, class V>
+void apply(Table& table, const workload_op& op){
+	K key = K(op.key);
+	if(op.type == op_type::read){
+		V ret_value;
+		table.get(key, ret_value);
+	}else if(op.type == op_type::remove){
+		table.remove(key);
+	}else{
+		table.set(key, V(key));
 	}
-	return double(sum) / double(vec.size());
 }
 
-double std_dev_vector(std::vector<testing_clock::duration::rep>& vec){
-	double avg = avg_vector(vec);
-	double sum = 0;
-	for(auto i = vec.begin(); i != vec.end(); ++i){
-		sum += std::pow(double(*i) - avg, 2.0);
+template <class Table, class K, class V>
+void prefill(Table& table, const workload& load){
+	for(std::uint64_t k = 0; k < load.prefill_count(); ++k){
+		table.set(K(k), V(K(k)));
 	}
-	return std::sqrt(sum / double(vec.size()));
 }
 
 template <class Table, class K, class V>
-void accessor(int id, Table& table, int ops){
-	std::vector<testing_clock::duration::rep> results;
+void timed_worker(Table& table, const std::vector<workload_op>& ops, int count, int sample_every, std::vector<latency_histogram>& totals, std::mutex& totals_mu){
+	latency_histogram results[op_types];
 	
-	K key;
-	V ret_value;
-	for(int i = 0; i < ops; ++i){
-		key = K(id * i);
+	std::size_t next = 0;
+	for(int i = 0; i < count; ++i){
+		const workload_op& op = ops[next];
+		next = next + 1 == ops.size() ? 0 : next + 1;
 		
+		if(i % sample_every != 0){
+			apply<Table, K, V>(table, op);
+			continue;
+		}
 		testing_clock::time_point start = testing_clock::now();
-		table.get(key, ret_value);
+		apply<Table, K, V>(table, op);
 		testing_clock::time_point end = testing_clock::now();
 		
-		results.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		results[int(op.type)].record(std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
 	}
 	
 	{
-		std::unique_lock lk(acc_vec_mu);
-		acc_vec.insert(acc_vec.end(), results.begin(), results.end());
+		std::unique_lock lk(totals_mu);
+		for(int t = 0; t < op_types; ++t){
+			totals[t].merge(results[t]);
+		}
 	}
 }
 
 template <class Table, class K, class V>
-void mutator(int id, Table& table, int ops){
-	std::vector<testing_clock::duration::rep> results;
-	
-	K key;
-	V value;
-	for(int i = 0; i < ops; ++i){
-		key = K(id * i);
-		value = V(key);
-		
-		testing_clock::time_point start = testing_clock::now();
-		table.set(key, value);
-		testing_clock::time_point end = testing_clock::now();
-		
-		results.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+std::uint64_t count_elements(const Table& table, const workload& load, const std::vector<std::vector<workload_op>>& ops){	//Not every table has a for_each, so this looks up every key the workload could have left behind.
+	std::vector<K> keys;
+	for(std::uint64_t k = 0; k < load.prefill_count(); ++k){
+		keys.push_back(K(k));
+	}
+	for(auto i = ops.begin(); i != ops.end(); ++i){
+		for(const workload_op& op : *i){
+			if(op.type == op_type::update || op.type == op_type::insert){
+				keys.push_back(K(op.key));
+			}
+		}
 	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
 	
-	{
-		std::unique_lock lk(mut_vec_mu);
-		mut_vec.insert(mut_vec.end(), results.begin(), results.end());
+	std::uint64_t elements = 0;
+	V ret_value;
+	for(const K& key : keys){
+		elements += table.get(key, ret_value) ? 1 : 0;
 	}
+	return elements;
 }
 
 template <class Table, class K, class V>
-void test_scenario(int acsrs, int mttrs, int ops_per){
-	Table table;
-	std::vector<std::thread> accessors;
-	std::vector<std::thread> mutators;
+scenario_result run_timed(int acsrs, int mttrs, int ops_per, int sample_every, const workload& load, int initial_size){	//Only every sample_every-th operation of each thread is timed.
+	Table table(initial_size);
+	prefill<Table, K, V>(table, load);
 	
+	std::vector<bool> is_accessor;	//Accessors only read and mutators only update, unless the workload gives its own mix.
+	std::vector<int> role_ids;	//Each thread's place among the accessors or the mutators.
 	for(int as = 0, ms = 0; as < acsrs || ms < mttrs;){
 		if(as < acsrs && ms < mttrs){
 			if(std::rand() % 2){
-				accessors.push_back(std::thread(accessor<Table, K, V>, as++, std::ref(table), ops_per));
+				is_accessor.push_back(true);
+				role_ids.push_back(as++);
 			}else{
-				mutators.push_back(std::thread(mutator<Table, K, V>, ms++, std::ref(table), ops_per));
+				is_accessor.push_back(false);
+				role_ids.push_back(ms++);
 			}
 		}else if(as < acsrs){
-			accessors.push_back(std::thread(accessor<Table, K, V>, as++, std::ref(table), ops_per));
+			is_accessor.push_back(true);
+			role_ids.push_back(as++);
 		}else if(ms < mttrs){
-			mutators.push_back(std::thread(mutator<Table, K, V>, ms++, std::ref(table), ops_per));
+			is_accessor.push_back(false);
+			role_ids.push_back(ms++);
 		}
 	}
 	
-	for(auto i = accessors.begin(); i != accessors.end(); ++i){
+	int n_threads = int(is_accessor.size());
+	std::vector<std::vector<workload_op>> ops(n_threads);
+	for(int t = 0; t < n_threads; ++t){
+		op_mix mix = load.options().custom_mix ? load.options().mix : is_accessor[t] ? op_mix{100, 0, 0, 0} : op_mix{0, 100, 0, 0};
+		int id = load.options().distribution == key_distribution::strided ? role_ids[t] : t;	//Strided keys have always been numbered by role, so that mutators write the keys accessors read.
+		ops[t] = load.generate(mix, id, n_threads, std::min(std::size_t(std::max(ops_per, 1)), op_buffer_limit));
+	}
+	
+	scenario_result result{0, std::uint64_t(n_threads) * std::uint64_t(std::max(ops_per, 0)), 0, -1, std::vector<latency_histogram>(op_types)};
+	std::mutex hists_mu;
+	std::vector<std::thread> workers;
+	testing_clock::time_point start = testing_clock::now();
+	for(int t = 0; t < n_threads; ++t){
+		workers.push_back(std::thread(timed_worker<Table, K, V>, std::ref(table), std::cref(ops[t]), ops_per, sample_every, std::ref(result.hists), std::ref(hists_mu)));
+	}
+	for(auto i = workers.begin(); i != workers.end(); ++i){
 		if(i->joinable()){
 			i->join();
 		}
 	}
-	for(auto i = mutators.begin(); i != mutators.end(); ++i){
-		if(i->joinable()){
+	result.seconds = std::chrono::duration<double>(testing_clock::now() - start).count();
+	result.elements = count_elements<Table, K, V>(table, load, ops);
+	if constexpr(has_chain_length<Table>::value){
+		result.chain_length = std::int64_t(table.chain_length());
+	}
+	return result;
+}
+
+template <class Table, class K, class V>
+void test_scenario(int acsrs, int mttrs, int ops_per, int sample_every, const workload& load){
+	scenario_result result = run_timed<Table, K, V>(acsrs, mttrs, ops_per, sample_every, load, 1);
+	
+	bool first = true;
+	for(int t = 0; t < op_types; ++t){
+		if(result.hists[t].count() != 0){
+			if(!first){
+				std::cout << "\n";
+			}
+			print_latencies(op_names[t], result.hists[t]);
+			first = false;
+		}
+	}
+}
+
+template <class Table, class K, class V>
+void throughput_worker(Table& table, const std::vector<workload_op>& ops, const std::atomic<bool>& go, const std::atomic<bool>& stop, double& ret_ops_per_sec){
+	std::uint64_t ops_done = 0;
+	std::size_t next = 0;
+	
+	while(!go.load(std::memory_order_acquire)){}
+	testing_clock::time_point start = testing_clock::now();
+	while(!stop.load(std::memory_order_relaxed)){
+		for(int i = 0; i < 64; ++i){	//Only checks the stop flag once every 64 operations.
+			apply<Table, K, V>(table, ops[next]);
+			next = next + 1 == ops.size() ? 0 : next + 1;	//Once the buffer wraps around, its inserts become updates.
+		}
+		ops_done += 64;
+	}
+	testing_clock::time_point end = testing_clock::now();
+	
+	ret_ops_per_sec = double(ops_done) / std::chrono::duration<double>(end - start).count();
+}
+
+template <class Table, class K, class V>
+void throughput_scenario(int max_threads, int write_percentage, double seconds, const workload& load){
+	op_mix mix = load.options().custom_mix ? load.options().mix : op_mix{100 - write_percentage, write_percentage, 0, 0};
+	for(int threads = 1; threads <= max_threads; ++threads){
+		Table table;
+		prefill<Table, K, V>(table, load);
+		std::vector<std::vector<workload_op>> ops(threads);
+		for(int t = 0; t < threads; ++t){
+			ops[t] = load.generate(mix, t, threads, op_buffer_limit);
+		}
+		
+		std::atomic<bool> go(false), stop(false);
+		std::vector<double> results(threads);
+		std::vector<std::thread> workers;
+		for(int t = 0; t < threads; ++t){
+			workers.push_back(std::thread(throughput_worker<Table, K, V>, std::ref(table), std::cref(ops[t]), std::cref(go), std::cref(stop), std::ref(results[t])));
+		}
+		go.store(true, std::memory_order_release);
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		stop.store(true, std::memory_order_relaxed);
+		for(auto i = workers.begin(); i != workers.end(); ++i){
 			i->join();
 		}
+		
+		double total = 0;
+		for(auto i = results.begin(); i != results.end(); ++i){
+			total += *i;
+		}
+		std::cout << "Threads: " << threads << "\n";
+		std::cout << "\tTotal: " << total << " ops/sec\n";
+		for(int t = 0; t < threads; ++t){
+			std::cout << "\tThread " << t << ": " << results[t] << " ops/sec\n";
+		}
+	}
+}
+
+template <class Table, class K, class V>
+void run_scenario(bool throughput, int a, int b, int c, int sample_every, const workload& load){	//Either accessors, mutators and operations per thread, or threads, write percentage and seconds.
+	if(throughput){
+		throughput_scenario<Table, K, V>(a, b, double(c), load);
+	}else{
+		test_scenario<Table, K, V>(a, b, c, sample_every, load);
+	}
+}
+
+struct sweep_options{
+	std::vector<int> tables = {0};	//use_lockfree values.
+	std::vector<int> accessors = {1};
+	std::vector<int> mutators = {1};
+	std::vector<int> ops = {10000};
+	std::vector<int> sizes = {1};	//Initial table sizes.
+	std::vector<std::string> key_types = {"int32"};
+	int sample_every = 1;
+	bool json = false;
+};
+
+bool parse_range(const std::string& value, std::vector<int>& ret_values){	//A comma separated list of numbers and lo-hi or lo-hi:step ranges.
+	std::vector<int> values;
+	std::size_t begin = 0;
+	while(begin <= value.size()){
+		std::size_t end = std::min(value.find(',', begin), value.size());
+		std::string item = value.substr(begin, end - begin);
+		std::size_t dash = item.find('-', 1), colon = item.find(':');
+		if(item.empty()){
+			return false;
+		}else if(dash == std::string::npos){
+			values.push_back(std::atoi(item.c_str()));
+		}else{
+			int lo = std::atoi(item.substr(0, dash).c_str()), hi = std::atoi(item.substr(dash + 1).c_str());
+			int step = colon != std::string::npos ? std::atoi(item.substr(colon + 1).c_str()) : 1;
+			if(step < 1 || hi < lo){
+				return false;
+			}
+			for(int x = lo; x <= hi; x += step){
+				values.push_back(x);
+			}
+		}
+		begin = end + 1;
+	}
+	ret_values = values;
+	return true;
+}
+
+bool parse_sweep_option(const std::string& arg, sweep_options& options){
+	std::size_t equals = arg.find('=');
+	if(equals == std::string::npos){
+		return false;
+	}
+	std::string name = arg.substr(0, equals), value = arg.substr(equals + 1);
+	if(name == "tables"){
+		return parse_range(value, options.tables);
+	}else if(name == "accessors"){
+		return parse_range(value, options.accessors);
+	}else if(name == "mutators"){
+		return parse_range(value, options.mutators);
+	}else if(name == "ops"){
+		return parse_range(value, options.ops);
+	}else if(name == "sizes"){
+		return parse_range(value, options.sizes);
+	}else if(name == "key_types"){
+		options.key_types.clear();
+		for(std::size_t begin = 0; begin <= value.size();){
+			std::size_t end = std::min(value.find(',', begin), value.size());
+			options.key_types.push_back(value.substr(begin, end - begin));
+			if(options.key_types.back() != "int32" && options.key_types.back() != "int64"){
+				return false;
+			}
+			begin = end + 1;
+		}
+		return true;
+	}else if(name == "sample_every"){
+		options.sample_every = std::max(1, std::atoi(value.c_str()));
+		return true;
+	}else if(name == "format"){
+		options.json = value == "json";
+		return value == "json" || value == "csv";
+	}
+	return false;
+}
+
+template <class K, class V, class F>
+void with_table(int use_lockfree, F&& f){	//Calls f with a table_tag for the chosen table, and its name.
+	if(use_lockfree == 10){
+		f(table_tag<lockfree::hash_table<K, V, std::hash<K>, std::equal_to<K>, lockfree::epoch_reclaimed<>, hashing::power_of_two_sizing<>>>(), "lockfree hash table with power of two sizes");
+	}else if(use_lockfree == 9){
+		f(table_tag<locking::robin_hood_hash_table<K, V>>(), "Robin Hood locking hash table");
+	}else if(use_lockfree == 8){
+		f(table_tag<locking::striped_hash_table<K, V, std::hash<K>, std::equal_to<K>, locking::seqlock_hash_table<K, V>>>(), "striped seqlock hash table");
+	}else if(use_lockfree == 7){
+		f(table_tag<locking::seqlock_hash_table<K, V>>(), "seqlock hash table");
+	}else if(use_lockfree == 6){
+		f(table_tag<locking::striped_hash_table<K, V>>(), "striped locking hash table");
+	}else if(use_lockfree == 5){
+		f(table_tag<lockfree::hash_table<K, V, std::hash<K>, std::equal_to<K>, lockfree::epoch_reclaimed<lockfree::default_epoch_domain, lockfree::pooled_allocator>>>(), "lockfree hash table with pooled nodes");
+	}else if(use_lockfree == 4){
+		f(table_tag<lockfree::hash_table<K, V, std::hash<K>, std::equal_to<K>, lockfree::hazard_reclaimed<>>>(), "hazard pointer lockfree hash table");
+	}else if(use_lockfree == 3){
+		f(table_tag<lockfree::hash_table<K, V, std::hash<K>, std::equal_to<K>, lockfree::ref_counted<>>>(), "reference counted lockfree hash table");
+	}else if(use_lockfree == 2){
+		f(table_tag<lockfree::flat_hash_table<K, V>>(), "flat lockfree hash table");
+	}else if(use_lockfree){
+		f(table_tag<lockfree::hash_table<K, V>>(), "lockfree hash table");
+	}else{
+		f(table_tag<locking::hash_table<K, V>>(), "locking hash table");
+	}
+}
+
+void print_row(const sweep_options& options, bool first, int table, const char* table_name, const std::string& key_type, int size, int acsrs, int mttrs, int ops_per, const workload& load, const scenario_result& result){	//One CSV line or JSON object per configuration.
+	const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+	const char* const percentile_names[] = {"p50", "p90", "p99", "p99_9", "p99_99"};
+	const char* const distribution_names[] = {"uniform", "zipfian", "hotspot", "sequential", "strided"};
+	std::vector<std::pair<std::string, std::string>> fields = {
+		{"table", std::to_string(table)}, {"table_name", table_name}, {"key_type", key_type}, {"initial_size", std::to_string(size)},
+		{"accessors", std::to_string(acsrs)}, {"mutators", std::to_string(mttrs)}, {"ops_per_thread", std::to_string(ops_per)},
+		{"distribution", distribution_names[int(load.options().distribution)]}, {"key_space", std::to_string(load.options().key_space)},
+		{"cpus", std::to_string(std::thread::hardware_concurrency())}, {"seconds", std::to_string(result.seconds)},
+		{"latency_run_ops_per_sec", std::to_string(result.seconds > 0 ? double(result.ops) / result.seconds : 0.0)}, {"elements", std::to_string(result.elements)},	//Slowed by timing the ops, so not a throughput, which --throughput measures.
+		{"chain_length", result.chain_length >= 0 ? std::to_string(result.chain_length) : options.json ? "null" : ""}	//Only the lockfree::hash_table tables keep a chain.
+	};
+	for(int t = 0; t < op_types; ++t){	//Latencies in microseconds.
+		std::string prefix = op_names[t];
+		std::transform(prefix.begin(), prefix.end(), prefix.begin(), [](char c){return char(std::tolower(c));});
+		const latency_histogram& hist = result.hists[t];
+		fields.emplace_back(prefix + "_samples", std::to_string(hist.count()));
+		fields.emplace_back(prefix + "_mean_us", std::to_string(hist.mean() / 1000.0));
+		for(int p = 0; p < 5; ++p){
+			fields.emplace_back(prefix + "_" + percentile_names[p] + "_us", std::to_string(double(hist.percentile(percentiles[p])) / 1000.0));
+		}
+		fields.emplace_back(prefix + "_max_us", std::to_string(double(hist.max()) / 1000.0));
 	}
 	
-	std::cout << "Accessor Average: " << avg_vector(acc_vec) / 1000.0 << " microseconds\n";
-	std::cout << "Accessor Standard Deviation: " << std_dev_vector(acc_vec) / 1000.0 << " microseconds\n\n";
-	std::cout << "Mutator Average: " << avg_vector(mut_vec) / 1000.0 << " microseconds\n";
-	std::cout << "Mutator Standard Deviation: " << std_dev_vector(mut_vec) / 1000.0 << " microseconds\n";
+	if(options.json){
+		std::cout << (first ? "[\n" : ",\n") << "  {";
+		for(std::size_t i = 0; i < fields.size(); ++i){
+			bool quoted = fields[i].first == "table_name" || fields[i].first == "key_type" || fields[i].first == "distribution";
+			std::cout << (i == 0 ? "" : ", ") << "\"" << fields[i].first << "\": " << (quoted ? "\"" : "") << fields[i].second << (quoted ? "\"" : "");
+		}
+		std::cout << "}" << std::flush;
+	}else{
+		if(first){
+			for(std::size_t i = 0; i < fields.size(); ++i){
+				std::cout << (i == 0 ? "" : ",") << fields[i].first;
+			}
+			std::cout << "\n";
+		}
+		for(std::size_t i = 0; i < fields.size(); ++i){
+			std::cout << (i == 0 ? "" : ",") << fields[i].second;
+		}
+		std::cout << std::endl;
+	}
+}
+
+template <class K, class V>
+void sweep_key_type(const sweep_options& options, const std::string& key_type, const workload& load, bool& first){
+	for(int table : options.tables){
+		with_table<K, V>(table, [&](auto tag, const char* table_name){
+			using Table = typename decltype(tag)::type;
+			for(int size : options.sizes){
+				for(int acsrs : options.accessors){
+					for(int mttrs : options.mutators){
+						for(int ops_per : options.ops){
+							std::cerr << "Running the " << table_name << " with " << key_type << " keys, size " << size << ", " << acsrs << " accessors, " << mttrs << " mutators and " << ops_per << " operations each...\n";
+							scenario_result result = run_timed<Table, K, V>(acsrs, mttrs, ops_per, options.sample_every, load, size);
+							print_row(options, first, table, table_name, key_type, size, acsrs, mttrs, ops_per, load, result);
+							first = false;
+						}
+					}
+				}
+			}
+		});
+	}
+}
+
+void sweep(const sweep_options& options, const workload& load){	//Runs every combination of the options, printing a row for each.
+	bool first = true;
+	for(const std::string& key_type : options.key_types){
+		if(key_type == "int64"){
+			sweep_key_type<std::int64_t, std::int64_t>(options, key_type, load, first);
+		}else{
+			sweep_key_type<std::int32_t, std::int32_t>(options, key_type, load, first);
+		}
+	}
+	if(options.json){
+		std::cout << (first ? "[\n]\n" : "\n]\n");
+	}
 }
 
 int main(int argc, char* argv[]){
 	std::srand(std::time(0));
 	
+	const char* program = argv[0];
+	bool throughput = argc > 1 && std::string(argv[1]) == "--throughput";
+	bool sweeping = argc > 1 && std::string(argv[1]) == "--sweep";
+	if(throughput || sweeping){
+		--argc;
+		++argv;
+	}
+	workload_options options;
+	sweep_options sweep_opts;
+	bool workload_given = false;
+	int positional = 1;
+	for(int i = 1; i < argc; ++i){	//Pulls the name=value options out from among the other arguments.
+		if(std::string(argv[i]).find('=') == std::string::npos){
+			argv[positional++] = argv[i];
+		}else if(sweeping && parse_sweep_option(argv[i], sweep_opts)){
+			continue;
+		}else if(parse_workload_option(argv[i], options)){
+			workload_given = true;
+		}else{
+			std::cerr << "Unknown or invalid option: " << argv[i] << "\n";
+			return -1;
+		}
+	}
+	argc = positional;
+	if(!throughput && !sweeping && !workload_given){	//Keeps the first form's timings what they always were: strided keys into an empty table.
+		options.distribution = key_distribution::strided;
+		options.prefill = 0;
+	}
+	
+	op_mix custom_mix = options.custom_mix ? options.mix : op_mix{100, 0, 0, 0};	//The modes' own mixes never insert.
+	if(sweeping){
+		workload load(options);
+		int n_threads = *std::max_element(sweep_opts.accessors.begin(), sweep_opts.accessors.end()) + *std::max_element(sweep_opts.mutators.begin(), sweep_opts.mutators.end());
+		std::size_t count = std::min(std::size_t(std::max(*std::max_element(sweep_opts.ops.begin(), sweep_opts.ops.end()), 1)), op_buffer_limit);
+		bool int32_keys = std::find(sweep_opts.key_types.begin(), sweep_opts.key_types.end(), "int32") != sweep_opts.key_types.end();
+		if(!(int32_keys ? keys_fit<std::int32_t>(load, custom_mix, n_threads, count) : keys_fit<std::int64_t>(load, custom_mix, n_threads, count))){
+			std::cerr << "The workload's keys would overflow the key type: use fewer keys, threads or operations.\n";
+			return -1;
+		}
+		sweep(sweep_opts, load);
+		return 0;
+	}
+	
 	if(argc < 5){
-		std::cerr << "Insufficient arguments:\n\tTry: " << argv[0] << " use_lockfree accessors mutators operations_per_thread\n\tIf use_lockfree is 0 the locking hash table is used, otherwise the lockfree hash table is used.\n";
+		std::cerr << "Insufficient arguments:\n\tTry: " << program << " use_lockfree accessors mutators operations_per_thread [sample_every]\n\tOr: " << program << " --throughput use_lockfree max_threads write_percentage seconds\n\tThe second form runs 1 to max_threads threads for the given time each, and reports operations per second.\n\tOr: " << program << " --sweep [tables=0,1] [accessors=1-4] [mutators=1] [ops=10000] [sizes=1] [key_types=int32,int64] [sample_every=1] [format=csv|json]\n\tThe third form runs the first form for every combination of the given lists (of numbers and lo-hi or lo-hi:step ranges), and prints one CSV line or JSON object for each.  Its latency_run_ops_per_sec includes reading the clock around each timed operation, so use the second form for throughput.\n\tThe first form times every sample_every-th operation (every operation by default), and reports percentiles of their latencies.\n\tAny form can be followed by workload options: dist=uniform|zipfian|hotspot|sequential|strided, theta=0.99 (Zipfian skew), hot=0.2 and hot_ops=0.8 (the hotspot's share of keys and operations), keys=65536 (the key space), prefill=n (keys set beforehand, all of them by default), and read=, update=, insert= and delete= (each thread's mix of operations, in place of the mode's own).\n\tWithout any, the first form starts from an empty table, and each accessor's and mutator's ith key is its number among them times i (dist=strided prefill=0).\n\tIf use_lockfree is 0 the locking hash table is used, if it is 2 the flat lockfree hash table is used, if it is 3 the reference counted lockfree hash table is used, if it is 4 the hazard pointer lockfree hash table is used, if it is 5 the lockfree hash table with pooled nodes is used, if it is 6 the striped locking hash table is used, if it is 7 the seqlock hash table is used, if it is 8 the striped seqlock hash table is used, if it is 9 the Robin Hood locking hash table is used, if it is 10 the lockfree hash table with power of two sizes is used, otherwise the (epoch reclaimed) lockfree hash table is used.\n";
 		return -1;
 	}
-	
-	if(std::atoi(argv[1])){
-		std::cout << "Using lockfree hash table...\n\n";
-		test_scenario<lockfree::hash_table<std::int32_t, std::int32_t>, std::int32_t, std::int32_t>(std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]));
-	}else{
-		std::cout << "Using locking hash table...\n\n";
-		test_scenario<locking::hash_table<std::int32_t, std::int32_t>, std::int32_t, std::int32_t>(std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]));
+	int sample_every = !throughput && argc > 5 ? std::max(1, std::atoi(argv[5])) : 1;
+	workload load(options);
+	int n_threads = throughput ? std::atoi(argv[2]) : std::atoi(argv[2]) + std::atoi(argv[3]);
+	std::size_t count = throughput ? op_buffer_limit : std::min(std::size_t(std::max(std::atoi(argv[4]), 1)), op_buffer_limit);
+	if(!keys_fit<std::int32_t>(load, custom_mix, n_threads, count)){
+		std::cerr << "The workload's keys would overflow the key type: use fewer keys, threads or operations.\n";
+		return -1;
 	}
 	
+	with_table<std::int32_t, std::int32_t>(std::atoi(argv[1]), [&](auto tag, const char* table_name){
+		std::cout << "Using " << table_name << "...\n\n";
+		run_scenario<typename decltype(tag)::type, std::int32_t, std::int32_t>(throughput, std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]), sample_every, load);
+	});
+	
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+#ifndef WORKLOAD_H_INCLUDED
+#define WORKLOAD_H_INCLUDED
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include "lib/hashing/sizing.hpp"
+
+/*
+ * A YCSB-like workload: which keys a benchmark's threads use, and what they
+ * do with them.
+ *
+ * Keys are drawn from [0, key_space) uniformly, from a Zipfian distribution
+ * (scrambled, so that the popular keys aren't neighbours), from a hotspot
+ * (hot_fraction of the keys get hot_op_fraction of the operations), or in
+ * sequence from a different start in each thread.  Strided keys are the
+ * ones table_timer has always used: thread id's ith key is id * i, whatever
+ * the key space.  Inserts use fresh keys above the key space.  Each
+ * thread's operations are generated up front, so that generating them isn't
+ * part of what's timed.
+ */
+enum class key_distribution{uniform, zipfian, hotspot, sequential, strided};
+enum class op_type{read, update, insert, remove};
+
+constexpr int op_types = 4;
+
+struct workload_op{
+	op_type type;
+	std::uint64_t key;
+};
+
+struct op_mix{	//Weights (usually percentages) of each type of operation.
+	int read;
+	int update;
+	int insert;
+	int remove;
+};
+
+struct workload_options{
+	key_distribution distribution = key_distribution::uniform;
+	double theta = 0.99;	//The Zipfian skew, in (0, 1).
+	double hot_fraction = 0.2;
+	double hot_op_fraction = 0.8;
+	std::uint64_t key_space = 1 << 16;
+	std::int64_t prefill = -1;	//Keys [0, prefill) are set before timing, -1 meaning the whole key space.
+	op_mix mix = {100, 0, 0, 0};
+	bool custom_mix = false;	//Whether mix was given, rather than left to the benchmark.
+};
+
+/*
+ * Zipfian ranks in [0, n), as generated by YCSB (after Gray et al., "Quickly
+ * Generating Billion-Record Synthetic Databases").  Construction is linear
+ * in n, and each rank after that takes constant time.
+ */
+class zipfian_generator{
+public:
+	
+	//Constructors/Destructor
+	zipfian_generator(std::uint64_t n, double theta);
+	
+	//Member Functions
+	std::uint64_t operator()(std::mt19937_64& rng) const;
+	
+private:
+	
+	//Data Members
+	std::uint64_t items;
+	double theta;
+	double alpha;
+	double zetan;
+	double eta;
+	
+};
+
+inline zipfian_generator::zipfian_generator(std::uint64_t n, double t) : items(std::max<std::uint64_t>(n, 1)), theta(t), alpha(1.0 / (1.0 - t)), zetan(0), eta(0){
+	for(std::uint64_t i = 1; i <= items; ++i){
+		zetan += 1.0 / std::pow(double(i), theta);
+	}
+	double zeta2 = 1.0 + 1.0 / std::pow(2.0, theta);
+	eta = (1.0 - std::pow(2.0 / double(items), 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+
+inline std::uint64_t zipfian_generator::operator()(std::mt19937_64& rng) const{
+	double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+	double uz = u * zetan;
+	if(uz < 1.0){
+		return 0;
+	}else if(uz < 1.0 + std::pow(0.5, theta)){
+		return std::min<std::uint64_t>(1, items - 1);
+	}
+	return std::min(items - 1, std::uint64_t(double(items) * std::pow(eta * u - eta + 1.0, alpha)));
+}
+
+class workload{
+public:
+	
+	//Constructors/Destructor
+	explicit workload(const workload_options& o) : opts(o), zipf(o.distribution == key_distribution::zipfian ? o.key_space : 1, o.theta) {}
+	
+	//Member Functions
+	const workload_options& options() const {return opts;}
+	std::uint64_t prefill_count() const {return opts.prefill < 0 ? opts.key_space : std::uint64_t(opts.prefill);}
+	std::vector<workload_op> generate(const op_mix& mix, int id, int n_threads, std::size_t count) const;
+	std::uint64_t key_bound(const op_mix& mix, int n_threads, std::size_t count) const;
+	
+private:
+	
+	//Data Members
+	workload_options opts;
+	zipfian_generator zipf;	//Only used (and only sized to the key space) for Zipfian keys.
+	
+	//Private Member Functions
+	std::uint64_t next_key(std::mt19937_64& rng, std::uint64_t& position) const;
+	
+};
+
+inline std::vector<workload_op> workload::generate(const op_mix& mix, int id, int n_threads, std::size_t count) const{	//The operations for thread id of n_threads.
+	std::mt19937_64 rng(0x9E3779B97F4A7C15ull * std::uint64_t(id + 1));
+	int total = mix.read + mix.update + mix.insert + mix.remove;
+	std::uint64_t position = opts.key_space * std::uint64_t(id) / std::uint64_t(std::max(n_threads, 1));	//Where sequential keys start.
+	
+	std::vector<workload_op> ops;
+	ops.reserve(count);
+	for(std::size_t i = 0; i < count; ++i){
+		int roll = total > 0 ? int(rng() % std::uint64_t(total)) : 0;
+		workload_op op;
+		if(total <= 0 || roll < mix.read){
+			op.type = op_type::read;
+		}else if(roll < mix.read + mix.update){
+			op.type = op_type::update;
+		}else if(roll < mix.read + mix.update + mix.insert){
+			op.type = op_type::insert;
+		}else{
+			op.type = op_type::remove;
+		}
+		if(op.type == op_type::insert){
+			op.key = opts.key_space + std::uint64_t(id) * count + i;
+		}else{
+			op.key = opts.distribution == key_distribution::strided ? std::uint64_t(id) * i : next_key(rng, position);
+		}
+		ops.push_back(op);
+	}
+	return ops;
+}
+
+inline std::uint64_t workload::key_bound(const op_mix& mix, int n_threads, std::size_t count) const{	//One past the largest key that prefilling or generate (for ids below n_threads) can give.
+	std::uint64_t bound = std::max(opts.key_space, prefill_count());
+	if(opts.distribution == key_distribution::strided){
+		bound = std::max(bound, std::uint64_t(std::max(n_threads, 1)) * count);
+	}
+	if(mix.insert > 0){
+		bound = std::max(bound, opts.key_space + std::uint64_t(std::max(n_threads, 1)) * count);
+	}
+	return bound;
+}
+
+inline std::uint64_t workload::next_key(std::mt19937_64& rng, std::uint64_t& position) const{
+	std::uint64_t n = std::max<std::uint64_t>(opts.key_space, 1);
+	switch(opts.distribution){
+	case key_distribution::zipfian:
+		return std::uint64_t(hashing::murmur_finalizer()(std::size_t(zipf(rng)))) % n;	//Scrambled, as in YCSB.
+	case key_distribution::hotspot:{
+		std::uint64_t hot = std::min(n, std::max<std::uint64_t>(1, std::uint64_t(double(n) * opts.hot_fraction)));
+		if(hot == n || std::uniform_real_distribution<double>(0.0, 1.0)(rng) < opts.hot_op_fraction){
+			return rng() % hot;
+		}
+		return hot + rng() % (n - hot);
+	}
+	case key_distribution::sequential:
+		return position++ % n;
+	default:
+		return rng() % n;
+	}
+}
+
+/*
+ * Parses a name=value argument into options, returning false if it isn't
+ * one.  The names are dist (uniform, zipfian, hotspot, sequential or
+ * strided), theta, hot, hot_ops, keys, prefill, and read, update, insert
+ * and delete for the mix.
+ */
+inline bool parse_workload_option(const std::string& arg, workload_options& options){
+	std::size_t equals = arg.find('=');
+	if(equals == std::string::npos){
+		return false;
+	}
+	std::string name = arg.substr(0, equals), value = arg.substr(equals + 1);
+	if(value.empty()){
+		return false;
+	}
+	
+	if(name == "dist"){
+		if(value == "uniform"){
+			options.distribution = key_distribution::uniform;
+		}else if(value == "zipfian"){
+			options.distribution = key_distribution::zipfian;
+		}else if(value == "hotspot"){
+			options.distribution = key_distribution::hotspot;
+		}else if(value == "sequential"){
+			options.distribution = key_distribution::sequential;
+		}else if(value == "strided"){
+			options.distribution = key_distribution::strided;
+		}else{
+			return false;
+		}
+	}else if(name == "theta"){
+		options.theta = std::atof(value.c_str());
+		return options.theta > 0.0 && options.theta < 1.0;
+	}else if(name == "hot"){
+		options.hot_fraction = std::atof(value.c_str());
+		return options.hot_fraction >= 0.0 && options.hot_fraction <= 1.0;
+	}else if(name == "hot_ops"){
+		options.hot_op_fraction = std::atof(value.c_str());
+		return options.hot_op_fraction >= 0.0 && options.hot_op_fraction <= 1.0;
+	}else if(name == "keys"){
+		options.key_space = std::max<std::uint64_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+	}else if(name == "prefill"){
+		options.prefill = std::atoll(value.c_str());
+		return options.prefill >= 0;
+	}else if(name == "read" || name == "update" || name == "insert" || name == "delete"){
+		if(!options.custom_mix){
+			options.mix = {0, 0, 0, 0};
+			options.custom_mix = true;
+		}
+		int weight = std::max(0, std::atoi(value.c_str()));
+		(name == "read" ? options.mix.read : name == "update" ? options.mix.update : name == "insert" ? options.mix.insert : options.mix.remove) = weight;
+	}else{
+		return false;
+	}
+	return true;
+}
+
+#endif
\ No newline at end of file